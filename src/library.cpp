@@ -0,0 +1,248 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QSet>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <utility>
+
+#include "library.h"
+
+typedef QPair<QString, Song*> TitleEntry;
+
+static bool titleLessThan(const TitleEntry &entry, const QString &title)
+{
+    return entry.first < title;
+}
+
+// Edit distance between the query and the closest prefix of the title,
+// giving up as soon as it is certain to exceed maxDistance; only cells within
+// maxDistance of the diagonal can stay in range so the rest are never filled,
+// and previous and current are scratch rows of at least query.length() +
+// maxDistance + 1 entries that are reused for every title
+static int prefixDistance(const QString &query, const QString &title, int maxDistance, int *previous, int *current)
+{
+    const int numColumns = qMin(title.length(), query.length() + maxDistance) + 1;
+    const int outOfRange = maxDistance + 1;
+    const QChar *queryData = query.constData();
+    const QChar *titleData = title.constData();
+
+    for (int j = 0; j < numColumns && j <= outOfRange; ++j) {
+        previous[j] = qMin(j, outOfRange);
+    }
+
+    int first = 1;
+    int last = 0;
+    for (int i = 1; i <= query.length(); ++i) {
+        first = qMax(1, i - maxDistance);
+        last = qMin(numColumns - 1, i + maxDistance);
+
+        current[first - 1] = first == 1 ? qMin(i, outOfRange) : outOfRange;
+        int rowMinimum = current[first - 1];
+        for (int j = first; j <= last; ++j) {
+            int substitution = previous[j - 1] + (queryData[i - 1] == titleData[j - 1] ? 0 : 1);
+            current[j] = qMin(qMin(substitution, qMin(previous[j], current[j - 1]) + 1), outOfRange);
+            rowMinimum = qMin(rowMinimum, current[j]);
+        }
+        if (last + 1 < numColumns) {
+            current[last + 1] = outOfRange;
+        }
+        if (rowMinimum > maxDistance) {
+            return rowMinimum;
+        }
+        std::swap(previous, current);
+    }
+
+    return *std::min_element(previous + first - 1, previous + qMax(last, first - 1) + 1);
+}
+
+Library::Library(QObject *parent)
+    : QObject(parent),
+      mPending(false)
+{
+    connect(&mWatcher, &QFutureWatcher<Song*>::finished, this, &Library::onFinished);
+}
+
+void Library::load(const QString &directory)
+{
+    // A load that has not been picked up yet is left to finish in the
+    // background and its songs are discarded rather than blocking here
+    if (mPending) {
+        QFutureWatcher<Song*> *previous = new QFutureWatcher<Song*>(this);
+        connect(previous, &QFutureWatcher<Song*>::finished, [previous]() {
+            qDeleteAll(previous->future().results());
+            previous->deleteLater();
+        });
+        previous->setFuture(mWatcher.future());
+    }
+
+    mPending = true;
+
+    mDirectory = directory;
+    mPendingFilenames.clear();
+
+    QDir dir(directory);
+    foreach (const QString &name, dir.entryList(QStringList("*.json"), QDir::Files, QDir::Name)) {
+        mPendingFilenames.append(dir.absoluteFilePath(name));
+    }
+
+    mWatcher.setFuture(QtConcurrent::mapped(mPendingFilenames, &Library::loadSong));
+}
+
+QList<Song*> Library::find(const QString &query, int limit) const
+{
+    QList<Song*> matches;
+    QSet<Song*> matched;
+
+    QString key = query.trimmed();
+    if (key.isEmpty()) {
+        return matches;
+    }
+
+    // Numbers are looked up directly
+    bool isNumber;
+    int number = key.toInt(&isNumber);
+    if (isNumber) {
+        foreach (Song *song, mNumbers.values(number)) {
+            if (matches.count() < limit) {
+                matches.append(song);
+                matched.insert(song);
+            }
+        }
+    }
+
+    // Titles starting with the query are adjacent in the sorted index
+    key = key.toCaseFolded();
+    auto i = std::lower_bound(mTitles.constBegin(), mTitles.constEnd(), key, titleLessThan);
+    for (; i != mTitles.constEnd() && i->first.startsWith(key) && matches.count() < limit; ++i) {
+        if (!matched.contains(i->second)) {
+            matches.append(i->second);
+            matched.insert(i->second);
+        }
+    }
+
+    // Fill any remaining space with titles that are a typo or two away
+    if (matches.count() < limit && key.length() >= 3) {
+        const int maxDistance = key.length() < 6 ? 1 : 2;
+
+        QVector<int> previous(key.length() + maxDistance + 1);
+        QVector<int> current(key.length() + maxDistance + 1);
+
+        QVector<QPair<int, Song*>> fuzzy;
+        foreach (const TitleEntry &entry, mTitles) {
+            int distance = prefixDistance(key, entry.first, maxDistance, previous.data(), current.data());
+            if (distance <= maxDistance && !matched.contains(entry.second)) {
+                fuzzy.append(qMakePair(distance, entry.second));
+            }
+        }
+
+        std::stable_sort(fuzzy.begin(), fuzzy.end(), [](const QPair<int, Song*> &a, const QPair<int, Song*> &b) {
+            return a.first < b.first;
+        });
+
+        for (int j = 0; j < fuzzy.count() && matches.count() < limit; ++j) {
+            matches.append(fuzzy.at(j).second);
+        }
+    }
+
+    return matches;
+}
+
+void Library::update(Song *song)
+{
+    if (!mFilenames.contains(song)) {
+        return;
+    }
+
+    // Move the song to its new place in the number and title indexes
+    for (QMultiHash<int, Song*>::iterator i = mNumbers.begin(); i != mNumbers.end();) {
+        if (i.value() == song) {
+            i = mNumbers.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    mNumbers.insert(song->number(), song);
+
+    for (int i = 0; i < mTitles.count(); ++i) {
+        if (mTitles.at(i).second == song) {
+            mTitles.remove(i);
+            break;
+        }
+    }
+    TitleEntry entry(song->title().toCaseFolded(), song);
+    mTitles.insert(std::upper_bound(mTitles.begin(), mTitles.end(), entry, [](const TitleEntry &a, const TitleEntry &b) {
+        return a.first < b.first;
+    }), entry);
+}
+
+void Library::onFinished()
+{
+    mPending = false;
+
+    qDeleteAll(mSongs);
+    mSongs.clear();
+    mFilenames.clear();
+    mSongsByFilename.clear();
+    mNumbers.clear();
+    mTitles.clear();
+
+    QList<Song*> songs = mWatcher.future().results();
+    for (int i = 0; i < songs.count(); ++i) {
+        Song *song = songs.at(i);
+        if (!song) {
+            continue;
+        }
+
+        song->setParent(this);
+        mSongs.append(song);
+        mFilenames.insert(song, mPendingFilenames.at(i));
+        mSongsByFilename.insert(mPendingFilenames.at(i), song);
+        mNumbers.insert(song->number(), song);
+        mTitles.append(qMakePair(song->title().toCaseFolded(), song));
+    }
+
+    std::sort(mTitles.begin(), mTitles.end(), [](const TitleEntry &a, const TitleEntry &b) {
+        return a.first < b.first;
+    });
+
+    emit loaded();
+}
+
+Song *Library::loadSong(const QString &filename)
+{
+    Song *song = new Song;
+    if (!song->loadFromFile(filename)) {
+        delete song;
+        return nullptr;
+    }
+
+    // The song was created on a worker thread but is owned by the library
+    song->moveToThread(QCoreApplication::instance()->thread());
+
+    return song;
+}
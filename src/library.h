@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "song.h"
+
+/**
+ * @brief In-memory collection of the songs in a directory.
+ *
+ * Songs are loaded in parallel and indexed by number and title so that they
+ * can be found while the user types without touching the disk.
+ */
+class Library : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit Library(QObject *parent = nullptr);
+
+    void load(const QString &directory);
+
+    const QString &directory() const { return mDirectory; }
+    const QList<Song*> &songs() const { return mSongs; }
+
+    QString filename(Song *song) const { return mFilenames.value(song); }
+    Song *song(const QString &filename) const { return mSongsByFilename.value(filename); }
+
+    QList<Song*> find(const QString &query, int limit = 10) const;
+
+    void update(Song *song);
+
+signals:
+
+    void loaded();
+
+private slots:
+
+    void onFinished();
+
+private:
+
+    static Song *loadSong(const QString &filename);
+
+    QString mDirectory;
+    QStringList mPendingFilenames;
+    QFutureWatcher<Song*> mWatcher;
+    bool mPending;
+
+    QList<Song*> mSongs;
+    QHash<Song*, QString> mFilenames;
+    QHash<QString, Song*> mSongsByFilename;
+    QMultiHash<int, Song*> mNumbers;
+    QVector<QPair<QString, Song*>> mTitles;
+};
+
+#endif // LIBRARY_H
@@ -0,0 +1,326 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QPair>
+#include <QRegExp>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrentMap>
+
+#include "libraryscanner.h"
+#include "song.h"
+
+// Incremented whenever the meaning of a cached record changes
+const quint32 CacheVersion = 1;
+
+const int ShingleSize = 3;
+const int SignatureSize = 64;
+const int BandSize = 4;
+const int DuplicateSimilarity = 80;
+
+static quint64 fnv1a(const QByteArray &data)
+{
+    quint64 hash = 14695981039346656037ULL;
+    foreach (char c, data) {
+        hash ^= static_cast<quint8>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static quint64 mix(quint64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// MinHash signature of the overlapping word sequences in the lyrics; the
+// fraction of equal values in two signatures estimates their similarity
+static QVector<quint32> lyricSignature(const Song &song)
+{
+    QRegExp separator("\\W+");
+
+    QStringList words;
+    foreach (const QString &text, song.lyrics()) {
+        words.append(text.toCaseFolded().split(separator, QString::SkipEmptyParts));
+    }
+
+    QVector<quint32> signature;
+    if (words.count() < ShingleSize) {
+        return signature;
+    }
+
+    signature.fill(0xffffffff, SignatureSize);
+    for (int i = 0; i + ShingleSize <= words.count(); ++i) {
+        quint64 hash = fnv1a(QStringList(words.mid(i, ShingleSize)).join(" ").toUtf8());
+        for (int j = 0; j < SignatureSize; ++j) {
+            quint32 value = static_cast<quint32>(mix(hash + j * 0x9e3779b97f4a7c15ULL));
+            if (value < signature.at(j)) {
+                signature[j] = value;
+            }
+        }
+    }
+
+    return signature;
+}
+
+/**
+ * @brief Produces the record for a single file on a worker thread.
+ */
+struct ScanFile
+{
+    typedef ScanRecord result_type;
+
+    explicit ScanFile(const QHash<QString, ScanRecord> &cache) : cache(cache) {}
+
+    ScanRecord operator()(const QString &filename) const
+    {
+        QFileInfo info(filename);
+
+        // Files that were not touched since the last scan are not even read
+        ScanRecord cached = cache.value(filename);
+        if (!cached.hash.isEmpty() && cached.size == info.size() && cached.modified == info.lastModified()) {
+            return cached;
+        }
+
+        ScanRecord record;
+        record.filename = filename;
+        record.size = info.size();
+        record.modified = info.lastModified();
+
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly)) {
+            record.error = file.errorString();
+            return record;
+        }
+
+        QByteArray data = file.readAll();
+        record.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+        // Files that were touched but not changed keep their previous result
+        if (record.hash == cached.hash) {
+            cached.size = record.size;
+            cached.modified = record.modified;
+            return cached;
+        }
+
+        Song song;
+        if (!song.loadFromData(data)) {
+            record.error = song.errorString();
+            return record;
+        }
+
+        record.number = song.number();
+        record.title = song.title();
+        record.numParts = song.lyrics().count();
+        for (QStringMap::const_iterator i = song.lyrics().constBegin(); i != song.lyrics().constEnd(); ++i) {
+            if (i.value().trimmed().isEmpty()) {
+                record.emptyParts.append(i.key());
+            }
+        }
+        record.signature = lyricSignature(song);
+
+        return record;
+    }
+
+    QHash<QString, ScanRecord> cache;
+};
+
+QDataStream &operator<<(QDataStream &stream, const ScanRecord &record)
+{
+    return stream << record.filename << record.size << record.modified << record.hash
+                  << record.error << record.number << record.title << record.numParts
+                  << record.emptyParts << record.signature;
+}
+
+QDataStream &operator>>(QDataStream &stream, ScanRecord &record)
+{
+    return stream >> record.filename >> record.size >> record.modified >> record.hash
+                  >> record.error >> record.number >> record.title >> record.numParts
+                  >> record.emptyParts >> record.signature;
+}
+
+LibraryScanner::LibraryScanner(QObject *parent)
+    : QObject(parent),
+      mCacheFilename(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath("scan.cache"))
+{
+    connect(&mWatcher, &QFutureWatcher<ScanRecord>::finished, this, &LibraryScanner::onFinished);
+
+    loadCache();
+}
+
+void LibraryScanner::scan(const QString &directory)
+{
+    if (mWatcher.isRunning()) {
+        return;
+    }
+
+    mDirectory = QDir(directory).absolutePath();
+
+    QStringList filenames;
+    QDir dir(mDirectory);
+    foreach (const QString &name, dir.entryList(QStringList("*.json"), QDir::Files, QDir::Name)) {
+        filenames.append(dir.absoluteFilePath(name));
+    }
+
+    mWatcher.setFuture(QtConcurrent::mapped(filenames, ScanFile(mCache)));
+}
+
+void LibraryScanner::onFinished()
+{
+    QList<ScanRecord> records = mWatcher.future().results();
+
+    // Only the records for the scanned directory are replaced so that the
+    // cache keeps serving any other library that has been scanned before
+    for (QHash<QString, ScanRecord>::iterator i = mCache.begin(); i != mCache.end();) {
+        if (QFileInfo(i.key()).absolutePath() == mDirectory) {
+            i = mCache.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    mIssues.clear();
+
+    QMap<int, QStringList> numbers;
+    QHash<QByteArray, QList<int>> buckets;
+
+    for (int i = 0; i < records.count(); ++i) {
+        const ScanRecord &record = records.at(i);
+        const QString name = QFileInfo(record.filename).fileName();
+
+        mCache.insert(record.filename, record);
+
+        if (!record.error.isEmpty()) {
+            mIssues.append(tr("%1: %2").arg(name).arg(record.error));
+            continue;
+        }
+
+        if (!record.numParts) {
+            mIssues.append(tr("%1: song has no parts").arg(name));
+        }
+        foreach (const QString &part, record.emptyParts) {
+            mIssues.append(tr("%1: part \"%2\" is empty").arg(name).arg(part));
+        }
+
+        if (record.number) {
+            numbers[record.number].append(name);
+        }
+
+        // Songs that share all of the values in any band of their signature
+        // are candidates for being near-duplicates
+        for (int band = 0; band + BandSize <= record.signature.count(); band += BandSize) {
+            QByteArray key(
+                reinterpret_cast<const char*>(record.signature.constData() + band),
+                BandSize * sizeof(quint32)
+            );
+            key.append(static_cast<char>(band));
+            buckets[key].append(i);
+        }
+    }
+
+    for (QMap<int, QStringList>::const_iterator i = numbers.constBegin(); i != numbers.constEnd(); ++i) {
+        if (i.value().count() > 1) {
+            mIssues.append(tr("Number %1 is used by %2").arg(i.key()).arg(i.value().join(", ")));
+        }
+    }
+
+    QSet<QPair<int, int>> compared;
+    foreach (const QList<int> &bucket, buckets) {
+        for (int a = 0; a < bucket.count(); ++a) {
+            for (int b = a + 1; b < bucket.count(); ++b) {
+                QPair<int, int> pair(bucket.at(a), bucket.at(b));
+                if (compared.contains(pair)) {
+                    continue;
+                }
+                compared.insert(pair);
+
+                const QVector<quint32> &first = records.at(pair.first).signature;
+                const QVector<quint32> &second = records.at(pair.second).signature;
+                int equal = 0;
+                for (int j = 0; j < SignatureSize; ++j) {
+                    if (first.at(j) == second.at(j)) {
+                        ++equal;
+                    }
+                }
+
+                int similarity = equal * 100 / SignatureSize;
+                if (similarity >= DuplicateSimilarity) {
+                    mIssues.append(tr("%1 and %2 have nearly identical lyrics (%3% similar)")
+                        .arg(QFileInfo(records.at(pair.first).filename).fileName())
+                        .arg(QFileInfo(records.at(pair.second).filename).fileName())
+                        .arg(similarity));
+                }
+            }
+        }
+    }
+
+    saveCache();
+
+    emit finished();
+}
+
+void LibraryScanner::loadCache()
+{
+    QFile file(mCacheFilename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_2);
+
+    quint32 version;
+    stream >> version;
+    if (version == CacheVersion) {
+        stream >> mCache;
+    }
+
+    // A truncated or corrupt cache is simply ignored
+    if (stream.status() != QDataStream::Ok) {
+        mCache.clear();
+    }
+}
+
+void LibraryScanner::saveCache()
+{
+    QDir().mkpath(QFileInfo(mCacheFilename).absolutePath());
+
+    QFile file(mCacheFilename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_2);
+    stream << CacheVersion << mCache;
+}
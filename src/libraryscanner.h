@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef LIBRARYSCANNER_H
+#define LIBRARYSCANNER_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Summary of a single song file produced by the scanner.
+ */
+struct ScanRecord
+{
+    ScanRecord() : size(-1), number(0), numParts(0) {}
+
+    QString filename;
+    qint64 size;
+    QDateTime modified;
+    QByteArray hash;
+
+    QString error;
+    int number;
+    QString title;
+    int numParts;
+    QStringList emptyParts;
+    QVector<quint32> signature;
+};
+
+QDataStream &operator<<(QDataStream &stream, const ScanRecord &record);
+QDataStream &operator>>(QDataStream &stream, ScanRecord &record);
+
+/**
+ * @brief Checks every song in a library for problems.
+ *
+ * Files are examined in parallel. The result for each file is cached along
+ * with its content hash so that a rescan only parses files that changed.
+ */
+class LibraryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit LibraryScanner(QObject *parent = nullptr);
+
+    void scan(const QString &directory);
+
+    bool isRunning() const { return mWatcher.isRunning(); }
+    const QStringList &issues() const { return mIssues; }
+
+signals:
+
+    void finished();
+
+private slots:
+
+    void onFinished();
+
+private:
+
+    void loadCache();
+    void saveCache();
+
+    QString mCacheFilename;
+    QString mDirectory;
+    QHash<QString, ScanRecord> mCache;
+    QFutureWatcher<ScanRecord> mWatcher;
+    QStringList mIssues;
+};
+
+#endif // LIBRARYSCANNER_H
@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QCryptographicHash>
+#include <QVector>
+#include <QtConcurrentRun>
+
+#include "linelayout.h"
+
+// Maximum number of rows kept in the cache across all layouts
+const int MaxCachedRows = 20000;
+
+LineLayout::LineLayout(QObject *parent)
+    : QObject(parent),
+      mCache(MaxCachedRows)
+{
+    connect(&mWatcher, &QFutureWatcher<QList<QChunkList>>::finished, this, &LineLayout::onFinished);
+}
+
+void LineLayout::start(const QList<QStringList> &rows, const QFont &font, int width)
+{
+    // The cache key covers everything that influences the result
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QStringList &row, rows) {
+        hash.addData(row.join("\t").toUtf8());
+        hash.addData("\n");
+    }
+    hash.addData(font.toString().toUtf8());
+    hash.addData(QByteArray::number(width));
+    QByteArray key = hash.result();
+
+    mPendingKey = key;
+
+    QList<QChunkList> *cached = mCache.object(key);
+    if (cached) {
+        mWatcher.cancel();
+        mChunks = *cached;
+        emit finished();
+        return;
+    }
+
+    mWatcher.setFuture(QtConcurrent::run(&LineLayout::layoutRows, rows, font, width));
+}
+
+QList<QChunkList> LineLayout::layoutRows(const QList<QStringList> &rows, const QFont &font, int width)
+{
+    QFontMetricsF metrics(font);
+
+    QList<QChunkList> chunks;
+    chunks.reserve(rows.count());
+    foreach (const QStringList &row, rows) {
+        QChunkList rowChunks;
+        int numChunks = 0;
+        foreach (const QString &line, row) {
+            rowChunks.append(splitLine(line, metrics, width));
+            numChunks = qMax(numChunks, rowChunks.last().count());
+        }
+
+        // Languages that needed fewer chunks are split again to match
+        for (int i = 0; i < rowChunks.count(); ++i) {
+            if (rowChunks.at(i).count() < numChunks) {
+                rowChunks[i] = splitLine(row.at(i), metrics, width, numChunks);
+            }
+        }
+
+        chunks.append(rowChunks);
+    }
+
+    return chunks;
+}
+
+QStringList LineLayout::splitLine(const QString &line, const QFontMetricsF &metrics, qreal width, int count)
+{
+    // Lines that already fit are left alone unless more chunks were requested
+    if (width <= 0 || (count <= 1 && metrics.width(line) <= width)) {
+        return QStringList(line);
+    }
+
+    QStringList words = line.split(' ', QString::SkipEmptyParts);
+    const int numWords = words.count();
+    if (numWords < 2) {
+        return QStringList(line);
+    }
+
+    QVector<qreal> wordWidths(numWords);
+    for (int i = 0; i < numWords; ++i) {
+        wordWidths[i] = metrics.width(words.at(i));
+    }
+    const qreal spaceWidth = metrics.width(' ');
+
+    // Choose the breaks that minimize the sum of the squared slack of every
+    // chunk (including the last one) so that chunks end up with similar widths
+    // instead of a full first chunk followed by a short remainder; cost[k][end]
+    // is the cost of placing the first end words in k chunks
+    const int maxChunks = count > 0 ? qMin(count, numWords) : numWords;
+    QVector<QVector<qreal>> cost(maxChunks + 1, QVector<qreal>(numWords + 1, -1));
+    QVector<QVector<int>> breaks(maxChunks + 1, QVector<int>(numWords + 1, 0));
+    cost[0][0] = 0;
+    for (int k = 1; k <= maxChunks; ++k) {
+        for (int end = k; end <= numWords; ++end) {
+            qreal chunkWidth = -spaceWidth;
+            for (int begin = end - 1; begin >= k - 1; --begin) {
+                chunkWidth += wordWidths.at(begin) + spaceWidth;
+
+                // A single word that is too wide must still occupy a chunk
+                if (chunkWidth > width && begin != end - 1) {
+                    break;
+                }
+                if (cost.at(k - 1).at(begin) < 0) {
+                    continue;
+                }
+
+                qreal slack = qMax<qreal>(width - chunkWidth, 0);
+                qreal total = cost.at(k - 1).at(begin) + slack * slack;
+                if (cost.at(k).at(end) < 0 || total < cost.at(k).at(end)) {
+                    cost[k][end] = total;
+                    breaks[k][end] = begin;
+                }
+            }
+        }
+    }
+
+    // Use the requested number of chunks or whichever number is cheapest
+    int numChunks = maxChunks;
+    if (count <= 0) {
+        for (int k = 1; k <= maxChunks; ++k) {
+            if (cost.at(k).at(numWords) >= 0 &&
+                    (cost.at(numChunks).at(numWords) < 0 || cost.at(k).at(numWords) < cost.at(numChunks).at(numWords))) {
+                numChunks = k;
+            }
+        }
+    }
+
+    QStringList chunks;
+    for (int k = numChunks, end = numWords; k > 0; end = breaks.at(k).at(end), --k) {
+        chunks.prepend(QStringList(words.mid(breaks.at(k).at(end), end - breaks.at(k).at(end))).join(" "));
+    }
+
+    return chunks;
+}
+
+void LineLayout::onFinished()
+{
+    // Layout that was superseded by a cached result is discarded
+    if (mWatcher.isCanceled()) {
+        return;
+    }
+
+    mChunks = mWatcher.result();
+    mCache.insert(mPendingKey, new QList<QChunkList>(mChunks), qMax(mChunks.count(), 1));
+    emit finished();
+}
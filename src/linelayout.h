@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef LINELAYOUT_H
+#define LINELAYOUT_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+typedef QList<QStringList> QChunkList;
+
+/**
+ * @brief Splits lines into chunks that fit within a pixel width.
+ *
+ * Each row holds the same line in one or more languages. Every language in a
+ * row is split into the same number of chunks where possible so that the
+ * languages advance together.
+ *
+ * Layout is performed on a worker thread and the result is cached for each
+ * combination of content, font, and width so that switching back to a file
+ * does not require measuring it again. The cache is limited to a total
+ * number of rows, with the least recently used layouts dropped first.
+ */
+class LineLayout : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit LineLayout(QObject *parent = nullptr);
+
+    void start(const QList<QStringList> &rows, const QFont &font, int width);
+
+    const QList<QChunkList> &chunks() const { return mChunks; }
+
+    static QList<QChunkList> layoutRows(const QList<QStringList> &rows, const QFont &font, int width);
+    static QStringList splitLine(const QString &line, const QFontMetricsF &metrics, qreal width, int count = 0);
+
+signals:
+
+    void finished();
+
+private slots:
+
+    void onFinished();
+
+private:
+
+    QFutureWatcher<QList<QChunkList>> mWatcher;
+    QCache<QByteArray, QList<QChunkList>> mCache;
+    QByteArray mPendingKey;
+    QList<QChunkList> mChunks;
+};
+
+#endif // LINELAYOUT_H
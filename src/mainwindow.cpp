@@ -22,45 +22,150 @@
  * IN THE SOFTWARE.
  */
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFontDialog>
 #include <QHBoxLayout>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QVBoxLayout>
 
 #include "mainwindow.h"
+#include "songeditor.h"
 
 const QString SettingDirectory("directory");
 const QString SettingGeometry("geometry");
+const QString SettingLayoutFont("layoutFont");
+const QString SettingLayoutWidth("layoutWidth");
+const QString SettingLibrary("library");
+const QString SettingSongbook("songbook");
+const QString SettingSessionChunk("session/chunk");
+const QString SettingSessionHash("session/hash");
+const QString SettingSessionLanguageOutputs("session/languageOutputs");
+const QString SettingSessionLanguages("session/languages");
+const QString SettingSessionLines("session/lines");
+const QString SettingSessionModified("session/modified");
+const QString SettingSessionOutput("session/output");
+const QString SettingSessionRow("session/row");
+const QString SettingSessionSize("session/size");
+const QString SettingSessionSong("session/song");
+const QString SettingSessionSource("session/source");
 const QString SettingWindowState("windowState");
 
+// Each row holds one line in every language, along with its chunks
+const int ChunksRole = Qt::UserRole;
+const int LinesRole = Qt::UserRole + 1;
+
 const QString LargeButtonStylesheet("QPushButton{padding: 16px 0;}");
 const QString LargeLabelStylesheet("QLabel{font-size: 12pt; font-weight: bold;}");
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       mSettings(new QSettings(this)),
+      mSnapshotFilename(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath("session.snapshot")),
+      mLayout(new LineLayout(this)),
+      mLibrary(new Library(this)),
+      mScanner(new LibraryScanner(this)),
+      mExporter(new SongbookExporter(this)),
       mFileContent(nullptr),
+      mCurrentChunk(0),
+      mJump(new QLineEdit),
+      mJumpModel(new QStringListModel(this)),
+      mJumpCompleter(new QCompleter(mJumpModel, this)),
+      mLibraryInfo(new QLabel(tr("[empty]"))),
       mOutputFile(new QLabel(tr("[empty]"))),
+      mLayoutInfo(new QLabel),
       mShowText(nullptr),
       mClearLine(nullptr),
       mShowLine(nullptr)
 {
     mFileContent = new QListWidget();
+    connect(mFileContent, &QListWidget::currentRowChanged, [this](int row) {
+        mCurrentChunk = 0;
+        mSettings->setValue(SettingSessionRow, row);
+        mSettings->setValue(SettingSessionChunk, 0);
+    });
+
+    connect(mLayout, &LineLayout::finished, this, &MainWindow::onLayoutFinished);
 
     auto loadFile = new QPushButton(tr("Load..."));
     loadFile->setStyleSheet(LargeButtonStylesheet);
     connect(loadFile, &QPushButton::clicked, this, &MainWindow::onLoadFileClicked);
 
+    // Song library and quick jump
+    connect(mLibrary, &Library::loaded, this, &MainWindow::onLibraryLoaded);
+    connect(mScanner, &LibraryScanner::finished, this, &MainWindow::onScanFinished);
+    connect(mExporter, &SongbookExporter::finished, this, &MainWindow::onExportFinished);
+
+    mJumpCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    connect(
+        mJumpCompleter,
+        static_cast<void (QCompleter::*)(const QModelIndex &)>(&QCompleter::activated),
+        [this](const QModelIndex &index) {
+            if (index.row() < mJumpMatches.count()) {
+                loadSong(mJumpMatches.at(index.row()));
+            }
+        }
+    );
+
+    mJump->setPlaceholderText(tr("Jump to song by number or title..."));
+    mJump->setCompleter(mJumpCompleter);
+    connect(mJump, &QLineEdit::textEdited, this, &MainWindow::onJumpEdited);
+    connect(mJump, &QLineEdit::returnPressed, this, &MainWindow::onJumpAccepted);
+
+    auto editSong = new QPushButton(tr("Edit song..."));
+    connect(editSong, &QPushButton::clicked, this, &MainWindow::onEditSongClicked);
+
+    QHBoxLayout *jumpLayout = new QHBoxLayout();
+    jumpLayout->addWidget(mJump, 1);
+    jumpLayout->addWidget(editSong, 0);
+
+    auto setLibrary = new QPushButton(tr("Set library..."));
+    connect(setLibrary, &QPushButton::clicked, this, &MainWindow::onSetLibraryClicked);
+
+    auto scanLibrary = new QPushButton(tr("Scan..."));
+    connect(scanLibrary, &QPushButton::clicked, this, &MainWindow::onScanLibraryClicked);
+
+    QHBoxLayout *libraryLayout = new QHBoxLayout();
+    libraryLayout->addWidget(mLibraryInfo, 1);
+    libraryLayout->addWidget(setLibrary, 0);
+    libraryLayout->addWidget(scanLibrary, 0);
+
+    auto exportSongbook = new QPushButton(tr("Export..."));
+    connect(exportSongbook, &QPushButton::clicked, this, &MainWindow::onExportSongbookClicked);
+    libraryLayout->addWidget(exportSongbook, 0);
+
     // Output selection
     auto setOutput = new QPushButton(tr("Set output file..."));
     connect(setOutput, &QPushButton::clicked, this, &MainWindow::onSetOutputClicked);
 
+    auto setLanguageOutput = new QPushButton(tr("Set language output..."));
+    connect(setLanguageOutput, &QPushButton::clicked, this, &MainWindow::onSetLanguageOutputClicked);
+
+    QVBoxLayout *outputButtonLayout = new QVBoxLayout();
+    outputButtonLayout->addWidget(setOutput);
+    outputButtonLayout->addWidget(setLanguageOutput);
+
     QHBoxLayout *outputLayout = new QHBoxLayout();
     outputLayout->addWidget(mOutputFile, 1);
-    outputLayout->addWidget(setOutput, 0);
+    outputLayout->addLayout(outputButtonLayout, 0);
+
+    // Line splitting
+    auto setLineWidth = new QPushButton(tr("Set line width..."));
+    connect(setLineWidth, &QPushButton::clicked, this, &MainWindow::onSetLayoutClicked);
+
+    QHBoxLayout *layoutLayout = new QHBoxLayout();
+    layoutLayout->addWidget(mLayoutInfo, 1);
+    layoutLayout->addWidget(setLineWidth, 0);
+
+    updateLayoutInfo();
 
     // Action buttons
     mShowText = new QPushButton(tr("Show Text..."));
@@ -86,16 +191,27 @@ MainWindow::MainWindow(QWidget *parent)
     auto contentLabel = new QLabel(tr("Lyric Content"));
     contentLabel->setStyleSheet(LargeLabelStylesheet);
 
+    auto libraryLabel = new QLabel(tr("Song Library"));
+    libraryLabel->setStyleSheet(LargeLabelStylesheet);
+
     auto outputLabel = new QLabel(tr("Output File"));
     outputLabel->setStyleSheet(LargeLabelStylesheet);
 
+    auto layoutLabel = new QLabel(tr("Line Splitting"));
+    layoutLabel->setStyleSheet(LargeLabelStylesheet);
+
     // Main layout for the application
     QVBoxLayout *vboxLayout = new QVBoxLayout;
     vboxLayout->addWidget(contentLabel);
     vboxLayout->addWidget(mFileContent);
     vboxLayout->addWidget(loadFile);
+    vboxLayout->addWidget(libraryLabel);
+    vboxLayout->addLayout(jumpLayout);
+    vboxLayout->addLayout(libraryLayout);
     vboxLayout->addWidget(outputLabel);
     vboxLayout->addLayout(outputLayout);
+    vboxLayout->addWidget(layoutLabel);
+    vboxLayout->addLayout(layoutLayout);
     vboxLayout->addLayout(actionLayout);
 
     QWidget *widget = new QWidget;
@@ -106,6 +222,14 @@ MainWindow::MainWindow(QWidget *parent)
     restoreGeometry(mSettings->value(SettingGeometry).toByteArray());
     restoreState(mSettings->value(SettingWindowState).toByteArray());
 
+    QString library = mSettings->value(SettingLibrary).toString();
+    if (!library.isEmpty()) {
+        mLibraryInfo->setText(tr("%1 [loading]").arg(library));
+        mLibrary->load(library);
+    }
+
+    restoreSession();
+
     setWindowIcon(QIcon(":/logo.png"));
     setWindowTitle(tr("EZLyric"));
 }
@@ -119,18 +243,166 @@ void MainWindow::onLoadFileClicked()
     );
     if (!filename.isNull()) {
         setDirectory(filename);
-        QFile file(filename);
-        if (file.open(QIODevice::ReadOnly)) {
-            mFileContent->clear();
-            foreach(auto line, QString::fromUtf8(file.readAll()).split("\n")) {
-                mFileContent->addItem(line.trimmed());
-            }
-        } else {
-            QMessageBox::critical(this, tr("Error"), file.errorString());
-        }
+        loadFile(filename);
+    }
+}
+
+void MainWindow::onSetLibraryClicked()
+{
+    auto directory = QFileDialog::getExistingDirectory(
+        this,
+        tr("Set Library"),
+        mSettings->value(SettingLibrary).toString()
+    );
+    if (!directory.isNull()) {
+        mSettings->setValue(SettingLibrary, directory);
+        mLibraryInfo->setText(tr("%1 [loading]").arg(directory));
+        mLibrary->load(directory);
+    }
+}
+
+void MainWindow::onLibraryLoaded()
+{
+    mLibraryInfo->setText(tr("%1 [%2 songs]").arg(mLibrary->directory()).arg(mLibrary->songs().count()));
+    mJumpMatches.clear();
+    mJumpModel->setStringList(QStringList());
+
+    // A restored song is shown from the snapshot straight away; only reload
+    // it if the song changed since the snapshot was taken
+    Song *song = mLibrary->song(mSettings->value(SettingSessionSong).toString());
+    if (song && hashRows(song->rows()) != mSettings->value(SettingSessionHash).toByteArray()) {
+        loadSong(song);
+    }
+}
+
+void MainWindow::onScanLibraryClicked()
+{
+    QString directory = mSettings->value(SettingLibrary).toString();
+    if (directory.isEmpty()) {
+        QMessageBox::critical(this, tr("Error"), tr("No library has been set."));
+        return;
+    }
+
+    if (!mScanner->isRunning()) {
+        mLibraryInfo->setText(tr("%1 [scanning]").arg(directory));
+        mScanner->scan(directory);
     }
 }
 
+void MainWindow::onScanFinished()
+{
+    mLibraryInfo->setText(tr("%1 [%2 songs]").arg(mLibrary->directory()).arg(mLibrary->songs().count()));
+
+    const QStringList &issues = mScanner->issues();
+    if (issues.isEmpty()) {
+        QMessageBox::information(this, tr("Scan Library"), tr("No problems were found."));
+        return;
+    }
+
+    QMessageBox messageBox(this);
+    messageBox.setIcon(QMessageBox::Warning);
+    messageBox.setWindowTitle(tr("Scan Library"));
+    messageBox.setText(tr("%1 problem(s) were found.").arg(issues.count()));
+    messageBox.setDetailedText(issues.join("\n"));
+    messageBox.exec();
+}
+
+void MainWindow::onExportSongbookClicked()
+{
+    if (mExporter->isRunning()) {
+        return;
+    }
+
+    if (mLibrary->songs().isEmpty()) {
+        QMessageBox::critical(this, tr("Error"), tr("The library does not contain any songs."));
+        return;
+    }
+
+    auto directory = QFileDialog::getExistingDirectory(
+        this,
+        tr("Export Songbook"),
+        mSettings->value(SettingSongbook).toString()
+    );
+    if (!directory.isNull()) {
+        mSettings->setValue(SettingSongbook, directory);
+        mLibraryInfo->setText(tr("%1 [exporting]").arg(mLibrary->directory()));
+        mExporter->start(mLibrary, directory);
+    }
+}
+
+void MainWindow::onExportFinished()
+{
+    mLibraryInfo->setText(tr("%1 [%2 songs]").arg(mLibrary->directory()).arg(mLibrary->songs().count()));
+
+    if (!mExporter->errorString().isNull()) {
+        QMessageBox::critical(this, tr("Error"), mExporter->errorString());
+        return;
+    }
+
+    QMessageBox::information(
+        this,
+        tr("Export Songbook"),
+        tr("%1 page(s) written, %2 unchanged.").arg(mExporter->numWritten()).arg(mExporter->numSkipped())
+    );
+}
+
+void MainWindow::onJumpEdited(const QString &text)
+{
+    mJumpMatches = mLibrary->find(text);
+
+    QStringList entries;
+    foreach (Song *song, mJumpMatches) {
+        entries.append(tr("%1 - %2").arg(song->number()).arg(song->title()));
+    }
+    mJumpModel->setStringList(entries);
+
+    if (!entries.isEmpty()) {
+        mJumpCompleter->complete();
+    }
+}
+
+void MainWindow::onJumpAccepted()
+{
+    if (!mJumpMatches.isEmpty()) {
+        loadSong(mJumpMatches.first());
+    }
+}
+
+void MainWindow::onEditSongClicked()
+{
+    QString filename = mSettings->value(SettingSessionSong).toString();
+    Song *song = mLibrary->song(filename);
+    if (!song) {
+        QMessageBox::critical(this, tr("Error"), tr("Jump to a song from the library to edit it."));
+        return;
+    }
+
+    SongEditor editor(song, this);
+    editor.setAutosaveFilename(filename + ".autosave", filename);
+    if (editor.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    // A library load that finishes while the editor is open replaces every
+    // song, so the song is looked up again rather than reused
+    song = mLibrary->song(filename);
+    if (!song) {
+        QMessageBox::critical(this, tr("Error"), tr("The song is no longer in the library."));
+        return;
+    }
+
+    editor.apply(song);
+    if (!song->saveToFile(filename)) {
+        QMessageBox::critical(this, tr("Error"), song->errorString());
+        return;
+    }
+
+    editor.discardAutosave();
+
+    mLibrary->update(song);
+    loadSong(song);
+}
+
 void MainWindow::onSetOutputClicked()
 {
     auto filename = QFileDialog::getSaveFileName(
@@ -140,11 +412,87 @@ void MainWindow::onSetOutputClicked()
     );
     if (!filename.isNull()) {
         setDirectory(filename);
-        mOutputFile->setText(filename);
-        mOutputFileName = filename;
-        mShowText->setEnabled(true);
-        mClearLine->setEnabled(true);
-        mShowLine->setEnabled(true);
+        setOutput(filename);
+    }
+}
+
+void MainWindow::onSetLanguageOutputClicked()
+{
+    bool ok;
+    QString language = QInputDialog::getItem(
+        this,
+        tr("Language Output"),
+        tr("Enter the language to output:"),
+        mLanguages,
+        0,
+        true,
+        &ok
+    );
+    if (!ok || language.isEmpty()) {
+        return;
+    }
+
+    auto filename = QFileDialog::getSaveFileName(
+        this,
+        tr("Set Output File for %1 (cancel to remove)").arg(language),
+        mSettings->value(SettingDirectory).toString()
+    );
+    if (filename.isNull()) {
+        mLanguageOutputs.remove(language);
+    } else {
+        setDirectory(filename);
+        mLanguageOutputs.insert(language, filename);
+    }
+
+    QVariantMap outputs;
+    for (QStringMap::const_iterator i = mLanguageOutputs.constBegin(); i != mLanguageOutputs.constEnd(); ++i) {
+        outputs.insert(i.key(), i.value());
+    }
+    mSettings->setValue(SettingSessionLanguageOutputs, outputs);
+
+    updateOutputInfo();
+}
+
+void MainWindow::onSetLayoutClicked()
+{
+    QFont defaultFont;
+    defaultFont.fromString(mSettings->value(SettingLayoutFont).toString());
+
+    bool ok;
+    QFont font = QFontDialog::getFont(&ok, defaultFont, this, tr("Output Font"));
+    if (!ok) {
+        return;
+    }
+
+    int width = QInputDialog::getInt(
+        this,
+        tr("Line Width"),
+        tr("Enter the output width in pixels (0 to disable splitting):"),
+        mSettings->value(SettingLayoutWidth, 0).toInt(),
+        0,
+        100000,
+        1,
+        &ok
+    );
+    if (!ok) {
+        return;
+    }
+
+    mSettings->setValue(SettingLayoutFont, font.toString());
+    mSettings->setValue(SettingLayoutWidth, width);
+    updateLayoutInfo();
+    updateLayout();
+}
+
+void MainWindow::onLayoutFinished()
+{
+    const QList<QChunkList> &chunks = mLayout->chunks();
+    if (chunks.count() != mFileContent->count()) {
+        return;
+    }
+
+    for (int i = 0; i < chunks.count(); ++i) {
+        mFileContent->item(i)->setData(ChunksRole, QVariant::fromValue(chunks.at(i)));
     }
 }
 
@@ -152,13 +500,13 @@ void MainWindow::onShowTextClicked()
 {
     auto text = QInputDialog::getText(this, tr("Input"), tr("Enter text to display below:"));
     if (!text.isNull()) {
-        outputLine(text);
+        outputLines(QStringList(text));
     }
 }
 
 void MainWindow::onClearLineClicked()
 {
-    outputLine("");
+    outputLines(QStringList());
 }
 
 void MainWindow::onShowLineClicked()
@@ -169,19 +517,28 @@ void MainWindow::onShowLineClicked()
         return;
     }
 
-    // Output the selected line
-    outputLine(mFileContent->currentItem()->text());
-
-    // Advance to the next line that contains text
-    const int numLines = mFileContent->count();
-    for (++line; line < numLines; ++line) {
-        const QString &lineText = mFileContent->item(line)->text();
-        if (!lineText.trimmed().isEmpty() && !lineText.startsWith("-")) {
-            break;
+    // Output the next chunk of the selected line in every language, staying
+    // on the line until every chunk has been shown; a language with fewer
+    // chunks keeps showing its last one
+    QChunkList chunks = mFileContent->currentItem()->data(ChunksRole).value<QChunkList>();
+    if (chunks.isEmpty()) {
+        outputLines(mFileContent->currentItem()->data(LinesRole).toStringList());
+    } else {
+        int numChunks = 0;
+        QStringList lines;
+        foreach (const QStringList &languageChunks, chunks) {
+            lines.append(languageChunks.value(qMin(mCurrentChunk, languageChunks.count() - 1)));
+            numChunks = qMax(numChunks, languageChunks.count());
+        }
+        outputLines(lines);
+        if (++mCurrentChunk < numChunks) {
+            mSettings->setValue(SettingSessionChunk, mCurrentChunk);
+            return;
         }
     }
 
-    mFileContent->setCurrentRow(line);
+    // Advance to the next line that contains text
+    mFileContent->setCurrentRow(nextLine(line));
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -191,14 +548,43 @@ void MainWindow::closeEvent(QCloseEvent *event)
     QMainWindow::closeEvent(event);
 }
 
-void MainWindow::outputLine(const QString &line)
+void MainWindow::outputLines(const QStringList &lines)
 {
-    QFile file(mOutputFileName);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(line.toUtf8());
-        file.close();
-    } else {
-        QMessageBox::critical(this, tr("Error"), file.errorString());
+    // The first line is for the primary output and the rest follow the order
+    // of the languages; outputs without a line are cleared
+    QList<QPair<QString, QString>> outputs;
+    outputs.append(qMakePair(mOutputFileName, lines.value(0)));
+    for (QStringMap::const_iterator i = mLanguageOutputs.constBegin(); i != mLanguageOutputs.constEnd(); ++i) {
+        int index = mLanguages.indexOf(i.key());
+        outputs.append(qMakePair(i.value(), index == -1 ? QString() : lines.value(index + 1)));
+    }
+
+    // Every file is written in full before any of them replaces its previous
+    // content so that the outputs change together
+    QList<QSaveFile*> files;
+    QString error;
+    for (int i = 0; i < outputs.count() && error.isNull(); ++i) {
+        QSaveFile *file = new QSaveFile(outputs.at(i).first);
+        files.append(file);
+        if (!file->open(QIODevice::WriteOnly) || file->write(outputs.at(i).second.toUtf8()) == -1) {
+            error = file->errorString();
+        }
+    }
+
+    foreach (QSaveFile *file, files) {
+        if (error.isNull()) {
+            if (!file->commit()) {
+                error = file->errorString();
+            }
+        } else {
+            file->cancelWriting();
+        }
+    }
+
+    qDeleteAll(files);
+
+    if (!error.isNull()) {
+        QMessageBox::critical(this, tr("Error"), error);
     }
 }
 
@@ -206,3 +592,230 @@ void MainWindow::setDirectory(const QString &filename)
 {
     mSettings->setValue(SettingDirectory, QFileInfo(filename).absolutePath());
 }
+
+void MainWindow::setOutput(const QString &filename)
+{
+    mOutputFileName = filename;
+    mShowText->setEnabled(true);
+    mClearLine->setEnabled(true);
+    mShowLine->setEnabled(true);
+    mSettings->setValue(SettingSessionOutput, filename);
+    updateOutputInfo();
+}
+
+void MainWindow::setLines(const QStringList &languages, const QList<QStringList> &rows)
+{
+    // The lines are written to the snapshot file once per load; only their
+    // hash is kept in the settings, which are rewritten on every row change
+    QByteArray hash = hashRows(rows);
+    if (hash != mSettings->value(SettingSessionHash).toByteArray() || !QFile::exists(mSnapshotFilename)) {
+        saveSnapshot(hash, languages, rows);
+    }
+    mSettings->setValue(SettingSessionHash, hash);
+
+    mLanguages = languages;
+
+    mFileContent->clear();
+    foreach (const QStringList &row, rows) {
+        // Show each language once, one below the other
+        QStringList text = row;
+        text.removeDuplicates();
+        text.removeAll(QString());
+
+        QListWidgetItem *item = new QListWidgetItem(text.join("\n"));
+        item->setData(LinesRole, row);
+        mFileContent->addItem(item);
+    }
+
+    updateLayout();
+}
+
+bool MainWindow::loadFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::critical(this, tr("Error"), file.errorString());
+        return false;
+    }
+
+    QList<QStringList> rows;
+    foreach(auto line, QString::fromUtf8(file.readAll()).split("\n")) {
+        rows.append(QStringList(line.trimmed()));
+    }
+
+    QFileInfo info(filename);
+    mSettings->setValue(SettingSessionSource, filename);
+    mSettings->setValue(SettingSessionSong, QString());
+    mSettings->setValue(SettingSessionSize, info.size());
+    mSettings->setValue(SettingSessionModified, info.lastModified());
+
+    setLines(QStringList(), rows);
+    return true;
+}
+
+void MainWindow::loadSong(Song *song)
+{
+    mSettings->setValue(SettingSessionSource, QString());
+    mSettings->setValue(SettingSessionSong, mLibrary->filename(song));
+
+    setLines(song->languages(), song->rows());
+    mFileContent->setCurrentRow(nextLine(-1));
+}
+
+void MainWindow::restoreSession()
+{
+    QVariantMap outputs = mSettings->value(SettingSessionLanguageOutputs).toMap();
+    for (QVariantMap::const_iterator i = outputs.constBegin(); i != outputs.constEnd(); ++i) {
+        mLanguageOutputs.insert(i.key(), i.value().toString());
+    }
+    updateOutputInfo();
+
+    QString output = mSettings->value(SettingSessionOutput).toString();
+    if (!output.isEmpty()) {
+        setOutput(output);
+    }
+
+    // Earlier versions kept the lines themselves in the settings
+    mSettings->remove(SettingSessionLanguages);
+    mSettings->remove(SettingSessionLines);
+
+    QString source = mSettings->value(SettingSessionSource).toString();
+    QByteArray hash = mSettings->value(SettingSessionHash).toByteArray();
+    QStringList languages;
+    QList<QStringList> rows;
+    loadSnapshot(hash, &languages, &rows);
+    int row = mSettings->value(SettingSessionRow, -1).toInt();
+    int chunk = mSettings->value(SettingSessionChunk, 0).toInt();
+
+    // The snapshot holds the lines as they were last shown, so the source file
+    // only needs to be read again if it was modified in the meantime; a source
+    // that cannot be found, such as one on a drive that is not mounted yet, is
+    // shown from the snapshot
+    QFileInfo info(source);
+    bool sourceChanged = !source.isEmpty() && info.exists() && (
+        info.size() != mSettings->value(SettingSessionSize).toLongLong() ||
+        info.lastModified() != mSettings->value(SettingSessionModified).toDateTime());
+    if (!sourceChanged && !rows.isEmpty()) {
+        setLines(languages, rows);
+    } else if (!source.isEmpty() && info.exists()) {
+        if (!loadFile(source)) {
+            return;
+        }
+    } else {
+        return;
+    }
+
+    // The position is only meaningful if the content is still the same
+    if (mSettings->value(SettingSessionHash).toByteArray() == hash) {
+        mFileContent->setCurrentRow(row);
+        mCurrentChunk = chunk;
+        mSettings->setValue(SettingSessionChunk, chunk);
+    } else {
+        mFileContent->setCurrentRow(nextLine(-1));
+    }
+}
+
+void MainWindow::saveSnapshot(const QByteArray &hash, const QStringList &languages, const QList<QStringList> &rows)
+{
+    QDir().mkpath(QFileInfo(mSnapshotFilename).absolutePath());
+
+    QSaveFile file(mSnapshotFilename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_2);
+    stream << hash << languages << rows;
+    file.commit();
+}
+
+bool MainWindow::loadSnapshot(const QByteArray &hash, QStringList *languages, QList<QStringList> *rows)
+{
+    QFile file(mSnapshotFilename);
+    if (hash.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_2);
+
+    // A snapshot of other lines than the ones in the settings is stale
+    QByteArray snapshotHash;
+    stream >> snapshotHash;
+    if (stream.status() != QDataStream::Ok || snapshotHash != hash) {
+        return false;
+    }
+
+    stream >> *languages >> *rows;
+    if (stream.status() != QDataStream::Ok) {
+        languages->clear();
+        rows->clear();
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray MainWindow::hashRows(const QList<QStringList> &rows)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QStringList &row, rows) {
+        hash.addData(row.join("\t").toUtf8());
+        hash.addData("\n");
+    }
+    return hash.result();
+}
+
+int MainWindow::nextLine(int line) const
+{
+    const int numLines = mFileContent->count();
+    for (++line; line < numLines; ++line) {
+        // A row is worth showing if any of its languages has text for it,
+        // even when the primary language is blank at that point
+        foreach (const QString &lineText, mFileContent->item(line)->data(LinesRole).toStringList()) {
+            if (!lineText.trimmed().isEmpty() && !lineText.startsWith("-")) {
+                return line;
+            }
+        }
+    }
+    return line;
+}
+
+void MainWindow::updateLayout()
+{
+    if (!mFileContent->count()) {
+        return;
+    }
+
+    QList<QStringList> rows;
+    for (int i = 0; i < mFileContent->count(); ++i) {
+        rows.append(mFileContent->item(i)->data(LinesRole).toStringList());
+    }
+
+    QFont font;
+    font.fromString(mSettings->value(SettingLayoutFont).toString());
+    mLayout->start(rows, font, mSettings->value(SettingLayoutWidth, 0).toInt());
+}
+
+void MainWindow::updateLayoutInfo()
+{
+    int width = mSettings->value(SettingLayoutWidth, 0).toInt();
+    if (width <= 0) {
+        mLayoutInfo->setText(tr("[disabled]"));
+        return;
+    }
+
+    QFont font;
+    font.fromString(mSettings->value(SettingLayoutFont).toString());
+    mLayoutInfo->setText(tr("%1, %2pt, %3px").arg(font.family()).arg(font.pointSize()).arg(width));
+}
+
+void MainWindow::updateOutputInfo()
+{
+    QStringList outputs(mOutputFileName.isEmpty() ? tr("[empty]") : mOutputFileName);
+    for (QStringMap::const_iterator i = mLanguageOutputs.constBegin(); i != mLanguageOutputs.constEnd(); ++i) {
+        outputs.append(tr("%1: %2").arg(i.key()).arg(i.value()));
+    }
+    mOutputFile->setText(outputs.join("\n"));
+}
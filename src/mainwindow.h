@@ -25,13 +25,21 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QCompleter>
 #include <QLabel>
 #include <QMainWindow>
+#include <QLineEdit>
 #include <QListWidget>
 #include <QPushButton>
 #include <QSettings>
+#include <QStringListModel>
 #include <QWidget>
 
+#include "library.h"
+#include "libraryscanner.h"
+#include "linelayout.h"
+#include "songbookexporter.h"
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -43,7 +51,19 @@ public:
 private slots:
 
     void onLoadFileClicked();
+    void onSetLibraryClicked();
+    void onLibraryLoaded();
+    void onScanLibraryClicked();
+    void onScanFinished();
+    void onExportSongbookClicked();
+    void onExportFinished();
+    void onJumpEdited(const QString &text);
+    void onJumpAccepted();
+    void onEditSongClicked();
     void onSetOutputClicked();
+    void onSetLanguageOutputClicked();
+    void onSetLayoutClicked();
+    void onLayoutFinished();
     void onShowTextClicked();
     void onClearLineClicked();
     void onShowLineClicked();
@@ -55,14 +75,43 @@ protected:
 private:
 
     void setDirectory(const QString &filename);
-    void outputLine(const QString &line);
+    void setOutput(const QString &filename);
+    void setLines(const QStringList &languages, const QList<QStringList> &rows);
+    bool loadFile(const QString &filename);
+    void loadSong(Song *song);
+    void restoreSession();
+    void saveSnapshot(const QByteArray &hash, const QStringList &languages, const QList<QStringList> &rows);
+    bool loadSnapshot(const QByteArray &hash, QStringList *languages, QList<QStringList> *rows);
+    int nextLine(int line) const;
+    void updateLayout();
+    void updateLayoutInfo();
+    void updateOutputInfo();
+    void outputLines(const QStringList &lines);
+
+    static QByteArray hashRows(const QList<QStringList> &rows);
 
     QSettings *mSettings;
+    QString mSnapshotFilename;
+    LineLayout *mLayout;
+    Library *mLibrary;
+    LibraryScanner *mScanner;
+    SongbookExporter *mExporter;
 
     QListWidget *mFileContent;
+    QStringList mLanguages;
+    int mCurrentChunk;
+
+    QLineEdit *mJump;
+    QStringListModel *mJumpModel;
+    QCompleter *mJumpCompleter;
+    QList<Song*> mJumpMatches;
+    QLabel *mLibraryInfo;
 
     QLabel *mOutputFile;
     QString mOutputFileName;
+    QStringMap mLanguageOutputs;
+
+    QLabel *mLayoutInfo;
 
     QPushButton *mShowText;
     QPushButton *mClearLine;
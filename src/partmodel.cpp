@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <utility>
+
+#include "partmodel.h"
+
+PartModel::PartModel(const Song *song, QObject *parent)
+    : QAbstractListModel(parent)
+{
+    foreach (const QString &name, song->parts()) {
+        Part part;
+        part.name = name;
+        part.document = createDocument(song->lyrics().value(name));
+        part.changed = false;
+        mParts.append(part);
+    }
+}
+
+int PartModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mParts.count();
+}
+
+QVariant PartModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= mParts.count()) {
+        return QVariant();
+    }
+
+    const Part &part = mParts.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return part.changed ? tr("%1 *").arg(part.name) : part.name;
+    case Qt::EditRole:
+        return part.name;
+    default:
+        return QVariant();
+    }
+}
+
+int PartModel::addPart(const QString &name)
+{
+    int existing = row(name);
+    if (existing != -1) {
+        return existing;
+    }
+
+    // Keep the parts in the same order as the song
+    int position = 0;
+    while (position < mParts.count() && Song::partLessThan(mParts.at(position).name, name)) {
+        ++position;
+    }
+
+    Part part;
+    part.name = name;
+    part.document = createDocument(QString());
+    part.changed = true;
+
+    // A new part is unsaved even while it is still empty
+    part.document->setModified(true);
+
+    beginInsertRows(QModelIndex(), position, position);
+    mParts.insert(position, part);
+    mUnsavedRemovals.remove(name);
+    endInsertRows();
+
+    return position;
+}
+
+void PartModel::removePart(int row)
+{
+    beginRemoveRows(QModelIndex(), row, row);
+    Part part = mParts.takeAt(row);
+    mRemoved.insert(part.name);
+    mUnsavedRemovals.insert(part.name);
+    delete part.document;
+    endRemoveRows();
+}
+
+void PartModel::restorePart(const QString &name, const QString &text)
+{
+    QTextDocument *document = mParts.at(addPart(name)).document;
+    document->setPlainText(text);
+    document->setModified(true);
+}
+
+int PartModel::row(const QString &name) const
+{
+    for (int i = 0; i < mParts.count(); ++i) {
+        if (mParts.at(i).name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QStringList PartModel::unsavedParts() const
+{
+    QStringList names;
+    foreach (const Part &part, mParts) {
+        if (part.document->isModified()) {
+            names.append(part.name);
+        }
+    }
+    return names;
+}
+
+QStringList PartModel::takeRemovedParts()
+{
+    QStringList names = mUnsavedRemovals.toList();
+    mUnsavedRemovals.clear();
+    return names;
+}
+
+void PartModel::markSaved(const QString &name)
+{
+    int i = row(name);
+    if (i != -1) {
+        mParts.at(i).document->setModified(false);
+    }
+}
+
+void PartModel::apply(Song *song) const
+{
+    // Start from the existing lyrics so that the text of unchanged parts is
+    // shared with the song rather than copied out of their documents
+    QStringMap lyrics = song->lyrics();
+    QTranslationMap translations = song->translations();
+    foreach (const QString &name, mRemoved) {
+        if (row(name) == -1) {
+            lyrics.remove(name);
+            for (QTranslationMap::iterator i = translations.begin(); i != translations.end(); ++i) {
+                i.value().remove(name);
+            }
+        }
+    }
+
+    // Parts that only exist in a translation are listed but stay out of the
+    // primary lyrics until something is written for them
+    foreach (const Part &part, mParts) {
+        if (part.changed) {
+            lyrics.insert(part.name, part.document->toPlainText());
+        }
+    }
+
+    song->setLyrics(std::move(lyrics));
+    song->setTranslations(translations);
+}
+
+QTextDocument *PartModel::createDocument(const QString &text)
+{
+    QTextDocument *document = new QTextDocument(text, this);
+    connect(document, &QTextDocument::contentsChanged, [this, document]() {
+        onContentsChanged(document);
+    });
+    return document;
+}
+
+void PartModel::onContentsChanged(QTextDocument *document)
+{
+    for (int i = 0; i < mParts.count(); ++i) {
+        if (mParts.at(i).document == document) {
+            if (!mParts.at(i).changed) {
+                mParts[i].changed = true;
+                emit dataChanged(index(i), index(i));
+            }
+            return;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PARTMODEL_H
+#define PARTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QTextDocument>
+
+#include "song.h"
+
+/**
+ * @brief List of the parts of a song being edited.
+ *
+ * Each part keeps its text in its own document so that switching between
+ * parts does not copy any text. Parts that were edited are tracked so that
+ * only those need to be written back to the song or autosaved.
+ */
+class PartModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+
+    explicit PartModel(const Song *song, QObject *parent = nullptr);
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    int addPart(const QString &name);
+    void removePart(int row);
+    void restorePart(const QString &name, const QString &text);
+
+    int row(const QString &name) const;
+    QString name(int row) const { return mParts.at(row).name; }
+    QTextDocument *document(int row) const { return mParts.at(row).document; }
+
+    QStringList unsavedParts() const;
+    QStringList takeRemovedParts();
+    void markSaved(const QString &name);
+
+    void apply(Song *song) const;
+
+private:
+
+    struct Part
+    {
+        QString name;
+        QTextDocument *document;
+        bool changed;
+    };
+
+    QTextDocument *createDocument(const QString &text);
+    void onContentsChanged(QTextDocument *document);
+
+    QList<Part> mParts;
+    QSet<QString> mRemoved;
+    QSet<QString> mUnsavedRemovals;
+};
+
+#endif // PARTMODEL_H
@@ -26,6 +26,9 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
+#include <QRegExp>
+
+#include <algorithm>
 
 #include "song.h"
 
@@ -33,6 +36,7 @@ static const char *KeyNumber = "number";
 static const char *KeyTitle = "title";
 static const char *KeyAuthor = "author";
 static const char *KeyLyrics = "lyrics";
+static const char *KeyTranslations = "translations";
 
 Song::Song(QObject *parent)
     : QObject(parent),
@@ -40,16 +44,113 @@ Song::Song(QObject *parent)
 {
 }
 
-bool Song::loadFromFile(const QString &filename)
+// Order parts with verses first, then choruses and bridges, numbering within
+// each kind of part compared numerically so that V10 follows V9
+bool Song::partLessThan(const QString &a, const QString &b)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        mError = file.errorString();
-        return false;
+    static const QString PrefixOrder("VCB");
+    static const QRegExp PartRegExp("^(\\D*)(\\d*)$");
+
+    QRegExp aMatch(PartRegExp);
+    QRegExp bMatch(PartRegExp);
+    aMatch.indexIn(a);
+    bMatch.indexIn(b);
+
+    // Unknown prefixes sort after the well-known ones
+    int aRank = aMatch.cap(1).length() == 1 ? PrefixOrder.indexOf(aMatch.cap(1)) : -1;
+    int bRank = bMatch.cap(1).length() == 1 ? PrefixOrder.indexOf(bMatch.cap(1)) : -1;
+    if (aRank == -1) {
+        aRank = PrefixOrder.length();
+    }
+    if (bRank == -1) {
+        bRank = PrefixOrder.length();
+    }
+    if (aRank != bRank) {
+        return aRank < bRank;
+    }
+
+    if (aMatch.cap(1) != bMatch.cap(1)) {
+        return aMatch.cap(1) < bMatch.cap(1);
+    }
+
+    if (aMatch.cap(2).toInt() != bMatch.cap(2).toInt()) {
+        return aMatch.cap(2).toInt() < bMatch.cap(2).toInt();
+    }
+
+    return a < b;
+}
+
+QStringList Song::parts() const
+{
+    // A translation may carry a part that the primary lyrics lack
+    QStringList parts = mLyrics.keys();
+    foreach (const QStringMap &translation, mTranslations) {
+        foreach (const QString &part, translation.keys()) {
+            if (!parts.contains(part)) {
+                parts.append(part);
+            }
+        }
+    }
+    std::stable_sort(parts.begin(), parts.end(), &Song::partLessThan);
+    return parts;
+}
+
+static QStringList partLines(const QString &text)
+{
+    QStringList lines;
+    foreach (const QString &line, text.split("\n")) {
+        lines.append(line.trimmed());
+    }
+    return lines;
+}
+
+QStringList Song::lines(const QString &language) const
+{
+    const QStringMap &lyrics = language.isEmpty() ? mLyrics : mTranslations[language];
+
+    QStringList lines;
+    foreach (const QString &part, parts()) {
+        lines.append(QString("- %1").arg(part));
+
+        // Every language is padded to the longest version of the part so
+        // that line N of one language lines up with line N of the others
+        int numLines = partLines(mLyrics.value(part)).count();
+        foreach (const QStringMap &translation, mTranslations) {
+            numLines = qMax(numLines, partLines(translation.value(part)).count());
+        }
+
+        QStringList textLines = partLines(lyrics.value(part));
+        while (textLines.count() < numLines) {
+            textLines.append(QString());
+        }
+        lines.append(textLines);
+    }
+    return lines;
+}
+
+QList<QStringList> Song::rows() const
+{
+    QList<QStringList> languageLines;
+    languageLines.append(lines());
+    foreach (const QString &language, languages()) {
+        languageLines.append(lines(language));
     }
 
+    QList<QStringList> rows;
+    for (int i = 0; i < languageLines.first().count(); ++i) {
+        QStringList row;
+        foreach (const QStringList &lines, languageLines) {
+            row.append(lines.at(i));
+        }
+        rows.append(row);
+    }
+    return rows;
+}
+
+bool Song::loadFromData(const QByteArray &data)
+{
     QJsonParseError error;
-    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    QJsonDocument document = QJsonDocument::fromJson(data, &error);
     if (document.isNull()) {
         mError = error.errorString();
         return false;
@@ -65,9 +166,28 @@ bool Song::loadFromFile(const QString &filename)
         mLyrics.insert(i.key(), i.value().toString());
     }
 
+    QJsonObject translations = object[KeyTranslations].toObject();
+    for (QJsonObject::const_iterator i = translations.constBegin(); i != translations.constEnd(); ++i) {
+        QJsonObject translation = i.value().toObject();
+        for (QJsonObject::const_iterator j = translation.constBegin(); j != translation.constEnd(); ++j) {
+            mTranslations[i.key()].insert(j.key(), j.value().toString());
+        }
+    }
+
     return true;
 }
 
+bool Song::loadFromFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        mError = file.errorString();
+        return false;
+    }
+
+    return loadFromData(file.readAll());
+}
+
 bool Song::saveToFile(const QString &filename)
 {
     QJsonObject lyrics;
@@ -75,6 +195,15 @@ bool Song::saveToFile(const QString &filename)
         lyrics[i.key()] = i.value();
     }
 
+    QJsonObject translations;
+    for (QTranslationMap::const_iterator i = mTranslations.constBegin(); i != mTranslations.constEnd(); ++i) {
+        QJsonObject translation;
+        for (QStringMap::const_iterator j = i.value().constBegin(); j != i.value().constEnd(); ++j) {
+            translation[j.key()] = j.value();
+        }
+        translations[i.key()] = translation;
+    }
+
     QJsonObject object{
         { KeyNumber, mNumber },
         { KeyTitle, mTitle },
@@ -82,6 +211,10 @@ bool Song::saveToFile(const QString &filename)
         { KeyLyrics, lyrics }
     };
 
+    if (!translations.isEmpty()) {
+        object[KeyTranslations] = translations;
+    }
+
     QFile file(filename);
     if (!file.open(QIODevice::WriteOnly)) {
         mError = file.errorString();
@@ -27,8 +27,12 @@
 
 #include <QMap>
 #include <QObject>
+#include <QStringList>
+
+#include <utility>
 
 typedef QMap<QString, QString> QStringMap;
+typedef QMap<QString, QStringMap> QTranslationMap;
 
 /**
  * @brief An individual song with lyrics.
@@ -40,6 +44,7 @@ class Song : public QObject
     Q_PROPERTY(QString title READ title WRITE setTitle)
     Q_PROPERTY(QString author READ author WRITE setAuthor)
     Q_PROPERTY(QStringMap lyrics READ lyrics WRITE setLyrics)
+    Q_PROPERTY(QTranslationMap translations READ translations WRITE setTranslations)
 
 public:
 
@@ -49,12 +54,23 @@ public:
     const QString &title() const { return mTitle; }
     const QString &author() const { return mAuthor; }
     const QStringMap &lyrics() const { return mLyrics; }
+    const QTranslationMap &translations() const { return mTranslations; }
 
     void setNumber(int number) { mNumber = number; }
     void setTitle(const QString &title) { mTitle = title; }
     void setAuthor(const QString &author) { mAuthor = author; }
     void setLyrics(const QStringMap &lyrics) { mLyrics = lyrics; }
+    void setLyrics(QStringMap &&lyrics) { mLyrics = std::move(lyrics); }
+    void setTranslations(const QTranslationMap &translations) { mTranslations = translations; }
+
+    QStringList languages() const { return mTranslations.keys(); }
+    QStringList parts() const;
+    QStringList lines(const QString &language = QString()) const;
+    QList<QStringList> rows() const;
+
+    static bool partLessThan(const QString &a, const QString &b);
 
+    bool loadFromData(const QByteArray &data);
     bool loadFromFile(const QString &filename);
     bool saveToFile(const QString &filename);
 
@@ -66,6 +82,7 @@ private:
     QString mTitle;
     QString mAuthor;
     QStringMap mLyrics;
+    QTranslationMap mTranslations;
     QString mError;
 };
 
@@ -0,0 +1,439 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QSet>
+#include <QUrl>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+
+#include "library.h"
+#include "songbookexporter.h"
+
+// Incremented whenever the markup of a page changes so that every page is
+// written again on the next export
+const int TemplateVersion = 2;
+
+// Song pages live in their own directory so that no song file name can
+// collide with the index or the files that support it
+const QString PagesDirectory("songs");
+
+const QString IndexFilename("index.html");
+const QString SearchFilename("search.js");
+const QString StylesheetFilename("style.css");
+const QString ManifestFilename("manifest.json");
+
+static const char *KeyVersion = "version";
+static const char *KeyPages = "pages";
+
+static const char *PageTemplate =
+    "<!DOCTYPE html>\n"
+    "<html>\n"
+    "<head>\n"
+    "<meta charset=\"utf-8\">\n"
+    "<title>%1</title>\n"
+    "<link rel=\"stylesheet\" href=\"../style.css\">\n"
+    "</head>\n"
+    "<body>\n"
+    "<p><a href=\"../index.html\">Index</a></p>\n"
+    "<h1>%1</h1>\n"
+    "%2"
+    "%3"
+    "</body>\n"
+    "</html>\n";
+
+static const char *IndexTemplate =
+    "<!DOCTYPE html>\n"
+    "<html>\n"
+    "<head>\n"
+    "<meta charset=\"utf-8\">\n"
+    "<title>Songbook</title>\n"
+    "<link rel=\"stylesheet\" href=\"style.css\">\n"
+    "<script src=\"search.js\"></script>\n"
+    "</head>\n"
+    "<body>\n"
+    "<h1>Songbook</h1>\n"
+    "<input id=\"search\" type=\"search\" placeholder=\"Search by number, title, author or lyrics\" autofocus>\n"
+    "<ul id=\"songs\">\n"
+    "%1"
+    "</ul>\n"
+    "<script>\n"
+    "function lowerBound(words, term) {\n"
+    "  var low = 0, high = words.length;\n"
+    "  while (low < high) {\n"
+    "    var mid = (low + high) >> 1;\n"
+    "    if (words[mid] < term) { low = mid + 1; } else { high = mid; }\n"
+    "  }\n"
+    "  return low;\n"
+    "}\n"
+    "function search(query) {\n"
+    "  var terms = query.toLowerCase().split(/[^\\p{L}\\p{N}]+/u).filter(function (term) { return term; });\n"
+    "  var matches = null;\n"
+    "  terms.forEach(function (term) {\n"
+    "    var found = {};\n"
+    "    for (var i = lowerBound(SONGBOOK.words, term); i < SONGBOOK.words.length && SONGBOOK.words[i].lastIndexOf(term, 0) === 0; ++i) {\n"
+    "      SONGBOOK.songs[i].forEach(function (id) { found[id] = true; });\n"
+    "    }\n"
+    "    if (matches !== null) {\n"
+    "      Object.keys(matches).forEach(function (id) { if (!found[id]) { delete matches[id]; } });\n"
+    "    } else {\n"
+    "      matches = found;\n"
+    "    }\n"
+    "  });\n"
+    "  var items = document.getElementById('songs').children;\n"
+    "  for (var i = 0; i < items.length; ++i) {\n"
+    "    items[i].hidden = matches !== null && !matches[items[i].getAttribute('data-id')];\n"
+    "  }\n"
+    "}\n"
+    "document.getElementById('search').addEventListener('input', function (event) {\n"
+    "  search(event.target.value);\n"
+    "});\n"
+    "</script>\n"
+    "</body>\n"
+    "</html>\n";
+
+static const char *Stylesheet =
+    "body { font-family: sans-serif; margin: 2em auto; max-width: 40em; padding: 0 1em; }\n"
+    "h2 { font-size: 1em; margin-bottom: 0.25em; }\n"
+    "p { margin-top: 0; }\n"
+    ".author { font-style: italic; }\n"
+    ".translation { color: #555; }\n"
+    "#search { box-sizing: border-box; font-size: 1.2em; padding: 0.5em; width: 100%; }\n"
+    "#songs { list-style: none; padding: 0; }\n";
+
+static QString pageTitle(int number, const QString &title)
+{
+    return number ? QString("%1. %2").arg(number).arg(title) : title;
+}
+
+// Lower-cased runs of letters and digits, splitting on the same characters
+// as the [^\p{L}\p{N}]+ pattern used by the search script
+static QStringList searchWords(const QString &text)
+{
+    const QString lower = text.toLower();
+
+    QStringList words;
+    QString word;
+    for (int i = 0; i < lower.length(); ++i) {
+        uint code = lower.at(i).unicode();
+        int length = 1;
+        if (lower.at(i).isHighSurrogate() && i + 1 < lower.length() && lower.at(i + 1).isLowSurrogate()) {
+            code = QChar::surrogateToUcs4(lower.at(i), lower.at(i + 1));
+            length = 2;
+        }
+
+        if (QChar::isLetterOrNumber(code)) {
+            word.append(lower.mid(i, length));
+        } else if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+        i += length - 1;
+    }
+    if (!word.isEmpty()) {
+        words.append(word);
+    }
+    return words;
+}
+
+// Whether a manifest key names a page this exporter could have written;
+// anything else, such as a key edited to point outside the songbook, must
+// never be overwritten or removed
+static bool isPageKey(const QString &key, int version)
+{
+    if (key.contains("..")) {
+        return false;
+    }
+
+    if (QRegExp(QString("%1/[^/\\\\:]+\\.html").arg(PagesDirectory)).exactMatch(key)) {
+        return true;
+    }
+
+    // Version 1 wrote the song pages next to the index
+    return version == 1 && QRegExp("[^/\\\\:]+\\.html").exactMatch(key);
+}
+
+static QString paragraph(const QString &text, const QString &attributes = QString())
+{
+    QStringList lines;
+    foreach (const QString &line, text.trimmed().split("\n")) {
+        lines.append(line.trimmed().toHtmlEscaped());
+    }
+    return QString("<p%1>%2</p>\n").arg(attributes, lines.join("<br>\n"));
+}
+
+/**
+ * @brief Renders and writes a single page on a worker thread.
+ */
+struct RenderPage
+{
+    typedef SongbookPage result_type;
+
+    RenderPage(const QString &directory, const QHash<QString, QByteArray> &manifest)
+        : directory(directory),
+          manifest(manifest)
+    {
+    }
+
+    SongbookPage operator()(const SongbookSong &song) const
+    {
+        SongbookPage page;
+        page.page = song.page;
+        page.number = song.number;
+        page.title = song.title;
+        page.author = song.author;
+
+        // Build the search terms for the index
+        QStringList text(song.title);
+        text.append(song.author);
+        text.append(song.lyrics.values());
+        foreach (const QStringMap &translation, song.translations) {
+            text.append(translation.values());
+        }
+        QStringList words = searchWords(text.join(" "));
+        if (song.number) {
+            words.append(QString::number(song.number));
+        }
+        words.removeDuplicates();
+        page.words = words;
+
+        // Render the page
+        QString body;
+        if (!song.author.isEmpty()) {
+            body.append(paragraph(song.author, " class=\"author\""));
+        }
+
+        QString parts;
+        foreach (const QString &part, song.parts) {
+            parts.append(QString("<h2>%1</h2>\n").arg(part.toHtmlEscaped()));
+            parts.append(paragraph(song.lyrics.value(part)));
+            for (QTranslationMap::const_iterator i = song.translations.constBegin(); i != song.translations.constEnd(); ++i) {
+                if (i.value().contains(part)) {
+                    parts.append(paragraph(
+                        i.value().value(part),
+                        QString(" class=\"translation\" lang=\"%1\"").arg(i.key().toHtmlEscaped())
+                    ));
+                }
+            }
+        }
+
+        QByteArray html = QString(PageTemplate)
+            .arg(pageTitle(song.number, song.title).toHtmlEscaped(), body, parts)
+            .toUtf8();
+
+        // Pages whose markup is unchanged are not written again
+        page.hash = QCryptographicHash::hash(html, QCryptographicHash::Sha1);
+        QString filename = QDir(directory).absoluteFilePath(song.page);
+        if (manifest.value(song.page) == page.hash && QFile::exists(filename)) {
+            return page;
+        }
+
+        QSaveFile file(filename);
+        if (!file.open(QIODevice::WriteOnly) || file.write(html) == -1 || !file.commit()) {
+            page.error = file.errorString();
+            return page;
+        }
+
+        page.written = true;
+        return page;
+    }
+
+    QString directory;
+    QHash<QString, QByteArray> manifest;
+};
+
+SongbookExporter::SongbookExporter(QObject *parent)
+    : QObject(parent),
+      mNumWritten(0),
+      mNumSkipped(0)
+{
+    connect(&mWatcher, &QFutureWatcher<SongbookPage>::finished, this, &SongbookExporter::onFinished);
+}
+
+void SongbookExporter::start(const Library *library, const QString &directory)
+{
+    if (mWatcher.isRunning()) {
+        return;
+    }
+
+    mDirectory = directory;
+    mNumWritten = 0;
+    mNumSkipped = 0;
+    mError.clear();
+
+    QDir(directory).mkpath(PagesDirectory);
+
+    // The songs may be replaced while the export is running so the data
+    // needed for each page is copied first
+    QList<SongbookSong> pages;
+    foreach (Song *song, library->songs()) {
+        SongbookSong page;
+        page.page = QString("%1/%2.html").arg(PagesDirectory, QFileInfo(library->filename(song)).completeBaseName());
+        page.number = song->number();
+        page.title = song->title();
+        page.author = song->author();
+        page.parts = song->parts();
+        page.lyrics = song->lyrics();
+        page.translations = song->translations();
+        pages.append(page);
+    }
+
+    // Load the hashes of the pages written by the previous export; the pages
+    // of an older template are still removed if they are no longer used
+    QHash<QString, QByteArray> manifest;
+    mPreviousPages.clear();
+    QFile file(QDir(directory).absoluteFilePath(ManifestFilename));
+    if (file.open(QIODevice::ReadOnly)) {
+        QJsonObject object = QJsonDocument::fromJson(file.readAll()).object();
+        const int version = object[KeyVersion].toInt();
+        QJsonObject hashes = object[KeyPages].toObject();
+        for (QJsonObject::const_iterator i = hashes.constBegin(); i != hashes.constEnd(); ++i) {
+            if (!isPageKey(i.key(), version)) {
+                continue;
+            }
+            if (version == TemplateVersion) {
+                manifest.insert(i.key(), QByteArray::fromHex(i.value().toString().toLatin1()));
+            }
+            mPreviousPages.append(i.key());
+        }
+    }
+
+    mWatcher.setFuture(QtConcurrent::mapped(pages, RenderPage(directory, manifest)));
+}
+
+void SongbookExporter::onFinished()
+{
+    QList<SongbookPage> pages = mWatcher.future().results();
+
+    std::stable_sort(pages.begin(), pages.end(), [](const SongbookPage &a, const SongbookPage &b) {
+        return a.number < b.number;
+    });
+
+    foreach (const SongbookPage &page, pages) {
+        if (!page.error.isNull()) {
+            mError = page.error;
+        } else if (page.written) {
+            ++mNumWritten;
+        } else {
+            ++mNumSkipped;
+        }
+    }
+
+    writeIndex(pages);
+
+    // Remove pages for songs that are no longer in the library, taking care
+    // not to remove the index written by this export
+    QSet<QString> current;
+    foreach (const SongbookPage &page, pages) {
+        current.insert(page.page);
+    }
+    current << IndexFilename << SearchFilename << StylesheetFilename << ManifestFilename;
+    foreach (const QString &page, mPreviousPages) {
+        if (!current.contains(page)) {
+            QFile::remove(QDir(mDirectory).absoluteFilePath(page));
+        }
+    }
+
+    emit finished();
+}
+
+void SongbookExporter::writeIndex(const QList<SongbookPage> &pages)
+{
+    QDir dir(mDirectory);
+
+    // Build the list of songs and the inverted index of sorted words
+    QString items;
+    QMap<QString, QList<int>> index;
+    QJsonObject hashes;
+    for (int i = 0; i < pages.count(); ++i) {
+        const SongbookPage &page = pages.at(i);
+
+        // Characters such as # and % in the file name would otherwise end or
+        // corrupt the link
+        QString link = QString("%1/%2").arg(
+            PagesDirectory,
+            QString::fromLatin1(QUrl::toPercentEncoding(QFileInfo(page.page).fileName()))
+        );
+        QString item = QString("<a href=\"%1\">%2</a>")
+            .arg(link.toHtmlEscaped(), pageTitle(page.number, page.title).toHtmlEscaped());
+        if (!page.author.isEmpty()) {
+            item.append(QString(" &mdash; %1").arg(page.author.toHtmlEscaped()));
+        }
+        items.append(QString("<li data-id=\"%1\">%2</li>\n").arg(i).arg(item));
+
+        foreach (const QString &word, page.words) {
+            index[word].append(i);
+        }
+
+        if (page.error.isNull()) {
+            hashes[page.page] = QString::fromLatin1(page.hash.toHex());
+        }
+    }
+
+    QJsonArray words;
+    QJsonArray songs;
+    for (QMap<QString, QList<int>>::const_iterator i = index.constBegin(); i != index.constEnd(); ++i) {
+        words.append(i.key());
+        QJsonArray ids;
+        foreach (int id, i.value()) {
+            ids.append(id);
+        }
+        songs.append(ids);
+    }
+
+    QJsonObject searchIndex{
+        { "words", words },
+        { "songs", songs }
+    };
+
+    QJsonObject manifest{
+        { KeyVersion, TemplateVersion },
+        { KeyPages, hashes }
+    };
+
+    QList<QPair<QString, QByteArray>> files;
+    files.append(qMakePair(IndexFilename, QString(IndexTemplate).arg(items).toUtf8()));
+    files.append(qMakePair(SearchFilename, "var SONGBOOK = " + QJsonDocument(searchIndex).toJson(QJsonDocument::Compact) + ";\n"));
+    files.append(qMakePair(StylesheetFilename, QByteArray(Stylesheet)));
+    files.append(qMakePair(ManifestFilename, QJsonDocument(manifest).toJson(QJsonDocument::Indented)));
+
+    for (int i = 0; i < files.count(); ++i) {
+        QSaveFile file(dir.absoluteFilePath(files.at(i).first));
+        if (!file.open(QIODevice::WriteOnly) || file.write(files.at(i).second) == -1 || !file.commit()) {
+            mError = file.errorString();
+            return;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef SONGBOOKEXPORTER_H
+#define SONGBOOKEXPORTER_H
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+#include "song.h"
+
+class Library;
+
+/**
+ * @brief Copy of the song data needed to render a page.
+ */
+struct SongbookSong
+{
+    SongbookSong() : number(0) {}
+
+    QString page;
+    int number;
+    QString title;
+    QString author;
+    QStringList parts;
+    QStringMap lyrics;
+    QTranslationMap translations;
+};
+
+/**
+ * @brief Result of rendering a single page.
+ */
+struct SongbookPage
+{
+    SongbookPage() : number(0), written(false) {}
+
+    QString page;
+    int number;
+    QString title;
+    QString author;
+    QByteArray hash;
+    QStringList words;
+    bool written;
+    QString error;
+};
+
+/**
+ * @brief Exports songs to a directory of static HTML pages.
+ *
+ * Pages are rendered and written in parallel. A manifest of content hashes
+ * is kept in the output directory so that pages for unchanged songs are not
+ * written again. An index page with a prebuilt search index is also created.
+ */
+class SongbookExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit SongbookExporter(QObject *parent = nullptr);
+
+    void start(const Library *library, const QString &directory);
+
+    bool isRunning() const { return mWatcher.isRunning(); }
+
+    int numWritten() const { return mNumWritten; }
+    int numSkipped() const { return mNumSkipped; }
+    QString errorString() const { return mError; }
+
+signals:
+
+    void finished();
+
+private slots:
+
+    void onFinished();
+
+private:
+
+    void writeIndex(const QList<SongbookPage> &pages);
+
+    QString mDirectory;
+    QStringList mPreviousPages;
+    QFutureWatcher<SongbookPage> mWatcher;
+
+    int mNumWritten;
+    int mNumSkipped;
+    QString mError;
+};
+
+#endif // SONGBOOKEXPORTER_H
@@ -22,39 +22,67 @@
  * IN THE SOFTWARE.
  */
 
+#include <QDateTime>
 #include <QDialogButtonBox>
+#include <QFile>
+#include <QFileInfo>
 #include <QFrame>
 #include <QGridLayout>
 #include <QHBoxLayout>
 #include <QIcon>
 #include <QInputDialog>
+#include <QItemSelectionModel>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
 #include <QLabel>
-#include <QList>
-#include <QListWidgetItem>
+#include <QMessageBox>
 #include <QPushButton>
+#include <QSaveFile>
 #include <QSplitter>
 #include <QVBoxLayout>
 
 #include "sizehintwidget.h"
 #include "songeditor.h"
+#include "texthistory.h"
 
-SongEditor::SongEditor(Song *song, QWidget *parent)
+static const char *KeyPart = "part";
+static const char *KeyText = "text";
+static const char *KeyRemoved = "removed";
+static const char *KeyMetadata = "metadata";
+static const char *KeyNumber = "number";
+static const char *KeyTitle = "title";
+static const char *KeyAuthor = "author";
+static const char *KeySong = "song";
+static const char *KeySize = "size";
+static const char *KeyModified = "modified";
+
+const int AutosaveInterval = 5000;
+
+// The oldest steps of a part's undo history are dropped beyond this many to
+// bound memory use
+const int MaxUndoSteps = 200;
+
+SongEditor::SongEditor(const Song *song, QWidget *parent)
     : QDialog(parent),
-      mSong(song),
+      mPartModel(new PartModel(song, this)),
+      mCurrentDocument(nullptr),
+      mEmptyDocument(new QTextDocument(this)),
+      mUndoGroup(new QUndoGroup(this)),
+      mAutosaveTimer(new QTimer(this)),
+      mMetadataSaved(false),
+      mNumRecords(0),
       mPartMenu(new QMenu(this)),
       mNumber(new QSpinBox),
       mTitle(new QLineEdit(song->title())),
       mAuthor(new QLineEdit(song->author())),
-      mPartList(new QListWidget),
+      mPartList(new QListView),
       mPartEditor(new QTextEdit)
 {
     // Add menu items for common parts
     foreach (const QString &part, QStringList({"V1", "V2", "V3", "V4", "V5", "V6", "C", "B"})) {
         mPartMenu->addAction(part, [this, part]() {
-            QListWidgetItem *item = new QListWidgetItem(part);
-            mPartList->addItem(item);
-            mPartList->setCurrentItem(item);
-            mPartEditor->setFocus();
+            addPart(part);
         });
     }
 
@@ -63,38 +91,62 @@ SongEditor::SongEditor(Song *song, QWidget *parent)
     mPartMenu->addAction(tr("&Custom..."), [this]() {
         QString text = QInputDialog::getText(this, tr("Custom Part"), tr("Enter name of custom part:"));
         if (!text.isNull()) {
-            QListWidgetItem *item = new QListWidgetItem(text);
-            mPartList->addItem(item);
-            mPartList->setCurrentItem(item);
-            mPartEditor->setFocus();
+            addPart(text);
         }
     });
 
     mNumber->setMaximum(999);
     mNumber->setValue(song->number());
 
-    // Initialize the part list
-    mPartList->setSortingEnabled(true);
-    connect(mPartList, &QListWidget::currentItemChanged, [this](QListWidgetItem *current, QListWidgetItem *previous) {
-        if (previous) {
-            previous->setData(Qt::UserRole, mPartEditor->toPlainText());
-        }
-        mPartEditor->setPlainText(current->data(Qt::UserRole).toString());
+    // Initialize the part list; each part has its own document which is
+    // shown in the editor when the part is selected
+    mPartList->setModel(mPartModel);
+    connect(mPartList->selectionModel(), &QItemSelectionModel::currentChanged, [this](const QModelIndex &current) {
+        setCurrentPart(current.row());
     });
 
     mPartEditor->setAcceptRichText(false);
 
-    // Add existing parts
-    for (QStringMap::const_iterator i = song->lyrics().constBegin(); i != song->lyrics().constEnd(); ++i) {
-        QListWidgetItem *item = new QListWidgetItem(i.key());
-        item->setData(Qt::UserRole, i.value());
-        mPartList->addItem(item);
-    }
+    // Undo and redo go to the history of the current part instead of the
+    // document, whose own undo stack is disabled
+    mPartEditor->installEventFilter(this);
+    mPartEditor->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(mPartEditor, &QTextEdit::customContextMenuRequested, [this](const QPoint &pos) {
+        QMenu *menu = mPartEditor->createStandardContextMenu(pos);
+        foreach (QAction *action, menu->actions()) {
+            if (action->objectName() == "edit-undo") {
+                menu->insertAction(action, mUndoGroup->createUndoAction(menu));
+                menu->removeAction(action);
+            } else if (action->objectName() == "edit-redo") {
+                menu->insertAction(action, mUndoGroup->createRedoAction(menu));
+                menu->removeAction(action);
+            }
+        }
+        menu->exec(mPartEditor->viewport()->mapToGlobal(pos));
+        delete menu;
+    });
 
-    mPartList->setCurrentRow(0);
+    mPartList->setCurrentIndex(mPartModel->index(0));
+    setCurrentPart(mPartList->currentIndex().row());
+
+    // Changed parts are periodically written to the autosave file
+    mAutosaveTimer->setInterval(AutosaveInterval);
+    connect(mAutosaveTimer, &QTimer::timeout, this, &SongEditor::onAutosave);
+    mAutosaveTimer->start();
+
+    // Changes that were accepted stay in the autosave file until the caller
+    // has saved the song and calls discardAutosave()
+    connect(this, &QDialog::finished, [this](int result) {
+        mAutosaveTimer->stop();
+        if (result == QDialog::Accepted) {
+            onAutosave();
+        } else {
+            discardAutosave();
+        }
+    });
 
     QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Save | QDialogButtonBox::Cancel, this);
-    connect(buttonBox, &QDialogButtonBox::accepted, this, &SongEditor::onAccepted);
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &SongEditor::accept);
     connect(buttonBox, &QDialogButtonBox::rejected, this, &SongEditor::close);
 
     QGridLayout *propLayout = new QGridLayout;
@@ -112,9 +164,9 @@ SongEditor::SongEditor(Song *song, QWidget *parent)
     QPushButton *partRemove = new QPushButton;
     partRemove->setIcon(QIcon(":/img/remove.png"));
     connect(partRemove, &QPushButton::clicked, [this]() {
-        int row = mPartList->currentRow();
+        int row = mPartList->currentIndex().row();
         if (row != -1) {
-            delete mPartList->takeItem(row);
+            removePart(row);
         }
     });
 
@@ -151,21 +203,270 @@ SongEditor::SongEditor(Song *song, QWidget *parent)
 
     resize(600, 800);
     setWindowTitle(tr("Add / Edit Song"));
+
+    mSavedMetadata = metadata();
 }
 
-void SongEditor::onAccepted()
+static QByteArray journalRecord(const QJsonObject &object)
 {
-    mSong->setNumber(mNumber->value());
-    mSong->setTitle(mTitle->text());
-    mSong->setAuthor(mAuthor->text());
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + "\n";
+}
 
-    QStringMap lyrics;
-    for (int i = 0; i < mPartList->count(); ++i) {
-        auto item = mPartList->item(i);
-        lyrics.insert(item->text(), item->data(Qt::UserRole).toString());
+void SongEditor::setAutosaveFilename(const QString &filename, const QString &songFilename)
+{
+    mAutosaveFilename = filename;
+
+    // The autosave file starts with the state of the song file it applies to
+    QFileInfo info(songFilename);
+    mAutosaveHeader = QJsonObject{
+        { KeySong, QJsonObject{
+            { KeySize, info.size() },
+            { KeyModified, info.lastModified().toMSecsSinceEpoch() }
+        } }
+    };
+
+    // Offer to recover the changes from an editor that was not closed
+    QFile file(filename);
+    if (file.open(QIODevice::ReadOnly)) {
+        QJsonObject header = QJsonDocument::fromJson(file.readLine()).object();
+        file.close();
+
+        QString text = tr("This song has unsaved changes from a previous session. Recover them?");
+        if (header != mAutosaveHeader) {
+            text = tr("This song has unsaved changes from a previous session, but the song "
+                      "has changed on disk since then. Recovering them will replace the "
+                      "newer text of the parts that were edited. Recover them anyway?");
+        }
+
+        auto button = QMessageBox::question(this, tr("Recover Changes"), text);
+        if (button == QMessageBox::Yes) {
+            recover();
+        } else {
+            QFile::remove(filename);
+        }
     }
+}
+
+void SongEditor::apply(Song *song) const
+{
+    song->setNumber(mNumber->value());
+    song->setTitle(mTitle->text());
+    song->setAuthor(mAuthor->text());
+
+    // Only the parts that were edited are copied out of their documents
+    mPartModel->apply(song);
+}
 
-    mSong->setLyrics(lyrics);
+void SongEditor::discardAutosave()
+{
+    if (!mAutosaveFilename.isEmpty()) {
+        QFile::remove(mAutosaveFilename);
+    }
+}
+
+bool SongEditor::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == mPartEditor && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        if (keyEvent->matches(QKeySequence::Undo)) {
+            mUndoGroup->undo();
+            return true;
+        }
+        if (keyEvent->matches(QKeySequence::Redo)) {
+            mUndoGroup->redo();
+            return true;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void SongEditor::onAutosave()
+{
+    if (mAutosaveFilename.isEmpty()) {
+        return;
+    }
+
+    QStringList removed = mPartModel->takeRemovedParts();
+    QStringList unsaved = mPartModel->unsavedParts();
+    QJsonObject current = metadata();
+    if (removed.isEmpty() && unsaved.isEmpty() && current == mSavedMetadata) {
+        return;
+    }
+
+    // Records are appended so that each autosave only writes the parts that
+    // changed since the last one; later records replace earlier ones
+    QFile file(mAutosaveFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+
+    if (!file.size()) {
+        file.write(journalRecord(mAutosaveHeader));
+    }
+
+    foreach (const QString &name, removed) {
+        file.write(journalRecord(QJsonObject{
+            { KeyPart, name },
+            { KeyRemoved, true }
+        }));
+        mSavedParts.insert(name);
+        ++mNumRecords;
+    }
+
+    foreach (const QString &name, unsaved) {
+        file.write(journalRecord(QJsonObject{
+            { KeyPart, name },
+            { KeyText, mPartModel->document(mPartModel->row(name))->toPlainText() }
+        }));
+        mPartModel->markSaved(name);
+        mSavedParts.insert(name);
+        ++mNumRecords;
+    }
+
+    if (current != mSavedMetadata) {
+        file.write(journalRecord(QJsonObject{ { KeyMetadata, current } }));
+        mSavedMetadata = current;
+        mMetadataSaved = true;
+        ++mNumRecords;
+    }
+
+    file.close();
+
+    // Once most of the records have been replaced by later ones the file is
+    // rewritten with only the latest record for each part
+    int numLive = mSavedParts.count() + (mMetadataSaved ? 1 : 0);
+    if (mNumRecords - numLive > numLive) {
+        compactAutosave();
+    }
+}
+
+void SongEditor::compactAutosave()
+{
+    QSaveFile file(mAutosaveFilename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    file.write(journalRecord(mAutosaveHeader));
+
+    foreach (const QString &name, mSavedParts) {
+        int row = mPartModel->row(name);
+        if (row == -1) {
+            file.write(journalRecord(QJsonObject{
+                { KeyPart, name },
+                { KeyRemoved, true }
+            }));
+        } else {
+            file.write(journalRecord(QJsonObject{
+                { KeyPart, name },
+                { KeyText, mPartModel->document(row)->toPlainText() }
+            }));
+            mPartModel->markSaved(name);
+        }
+    }
+    mPartModel->takeRemovedParts();
+
+    if (mMetadataSaved) {
+        mSavedMetadata = metadata();
+        file.write(journalRecord(QJsonObject{ { KeyMetadata, mSavedMetadata } }));
+    }
+
+    if (file.commit()) {
+        mNumRecords = mSavedParts.count() + (mMetadataSaved ? 1 : 0);
+    }
+}
+
+QJsonObject SongEditor::metadata() const
+{
+    return QJsonObject{
+        { KeyNumber, mNumber->value() },
+        { KeyTitle, mTitle->text() },
+        { KeyAuthor, mAuthor->text() }
+    };
+}
+
+void SongEditor::addPart(const QString &name)
+{
+    mPartList->setCurrentIndex(mPartModel->index(mPartModel->addPart(name)));
+    mPartEditor->setFocus();
+}
+
+void SongEditor::removePart(int row)
+{
+    // The editor must not be left showing a document that is about to be deleted
+    if (mPartModel->document(row) == mCurrentDocument) {
+        mCurrentDocument = nullptr;
+        mPartEditor->setDocument(mEmptyDocument);
+        mPartEditor->setEnabled(false);
+    }
+
+    mPartModel->removePart(row);
+}
+
+void SongEditor::setCurrentPart(int row)
+{
+    QTextDocument *document = row == -1 ? nullptr : mPartModel->document(row);
+    if (document && document == mCurrentDocument) {
+        return;
+    }
+
+    mCurrentDocument = document;
+    mPartEditor->setDocument(mCurrentDocument ? mCurrentDocument : mEmptyDocument);
+    mPartEditor->setEnabled(mCurrentDocument != nullptr);
+
+    // Each part keeps its own bounded history, created when it is first shown
+    TextHistory *history = nullptr;
+    if (mCurrentDocument) {
+        history = mCurrentDocument->findChild<TextHistory*>(QString(), Qt::FindDirectChildrenOnly);
+        if (!history) {
+            history = new TextHistory(mCurrentDocument, MaxUndoSteps);
+            mUndoGroup->addStack(history);
+        }
+    }
+    mUndoGroup->setActiveStack(history);
+}
+
+void SongEditor::recover()
+{
+    QFile file(mAutosaveFilename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    while (!file.atEnd()) {
+        QJsonObject object = QJsonDocument::fromJson(file.readLine()).object();
+        if (object.contains(KeyMetadata)) {
+            QJsonObject metadata = object[KeyMetadata].toObject();
+            mNumber->setValue(metadata[KeyNumber].toInt());
+            mTitle->setText(metadata[KeyTitle].toString());
+            mAuthor->setText(metadata[KeyAuthor].toString());
+            mMetadataSaved = true;
+            continue;
+        }
+
+        QString name = object[KeyPart].toString();
+        if (name.isEmpty()) {
+            continue;
+        }
+        mSavedParts.insert(name);
+
+        if (object[KeyRemoved].toBool()) {
+            int row = mPartModel->row(name);
+            if (row != -1) {
+                removePart(row);
+            }
+        } else {
+            mPartModel->restorePart(name, object[KeyText].toString());
+        }
+    }
+
+    file.close();
+
+    if (!mCurrentDocument && mPartModel->rowCount()) {
+        mPartList->setCurrentIndex(mPartModel->index(0));
+    }
 
-    close();
+    // Start the file again with only what was recovered, relative to the
+    // song file as it is now
+    compactAutosave();
 }
@@ -26,13 +26,19 @@
 #define SONGEDITOR_H
 
 #include <QDialog>
+#include <QJsonObject>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
 #include <QMenu>
+#include <QSet>
 #include <QSpinBox>
+#include <QTextDocument>
 #include <QTextEdit>
+#include <QTimer>
+#include <QUndoGroup>
 #include <QWidget>
 
+#include "partmodel.h"
 #include "song.h"
 
 /**
@@ -44,22 +50,49 @@ class SongEditor : public QDialog
 
 public:
 
-    SongEditor(Song *song, QWidget *parent = nullptr);
+    SongEditor(const Song *song, QWidget *parent = nullptr);
+
+    void setAutosaveFilename(const QString &filename, const QString &songFilename);
+
+    void apply(Song *song) const;
+    void discardAutosave();
+
+protected:
+
+    virtual bool eventFilter(QObject *watched, QEvent *event);
 
 private slots:
 
-    void onAccepted();
+    void onAutosave();
 
 private:
 
-    Song *mSong;
+    void addPart(const QString &name);
+    void removePart(int row);
+    void setCurrentPart(int row);
+    void recover();
+    void compactAutosave();
+    QJsonObject metadata() const;
+
+    PartModel *mPartModel;
+    QTextDocument *mCurrentDocument;
+    QTextDocument *mEmptyDocument;
+    QUndoGroup *mUndoGroup;
+
+    QString mAutosaveFilename;
+    QTimer *mAutosaveTimer;
+    QJsonObject mAutosaveHeader;
+    QJsonObject mSavedMetadata;
+    QSet<QString> mSavedParts;
+    bool mMetadataSaved;
+    int mNumRecords;
 
     QMenu *mPartMenu;
 
     QSpinBox *mNumber;
     QLineEdit *mTitle;
     QLineEdit *mAuthor;
-    QListWidget *mPartList;
+    QListView *mPartList;
     QTextEdit *mPartEditor;
 };
 
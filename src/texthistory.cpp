@@ -0,0 +1,152 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <QTextCursor>
+#include <QUndoCommand>
+
+#include "texthistory.h"
+
+/**
+ * @brief A single change to the text of a document.
+ */
+class TextChange : public QUndoCommand
+{
+public:
+
+    TextChange(TextHistory *history, int position, const QString &removed, const QString &added)
+        : mHistory(history),
+          mPosition(position),
+          mRemoved(removed),
+          mAdded(added),
+          mApplied(true)
+    {
+    }
+
+    virtual void undo()
+    {
+        mHistory->replace(mPosition, mAdded.length(), mRemoved);
+    }
+
+    virtual void redo()
+    {
+        // The change has already been made when the command is pushed
+        if (mApplied) {
+            mApplied = false;
+            return;
+        }
+        mHistory->replace(mPosition, mRemoved.length(), mAdded);
+    }
+
+    virtual int id() const { return 1; }
+
+    // Characters typed or deleted one at a time are undone a word at a time
+    virtual bool mergeWith(const QUndoCommand *command)
+    {
+        const TextChange *other = static_cast<const TextChange*>(command);
+
+        if (mRemoved.isEmpty() && other->mRemoved.isEmpty() && other->mAdded.length() == 1) {
+            if (other->mPosition != mPosition + mAdded.length() || other->mAdded.at(0) == QLatin1Char('\n')) {
+                return false;
+            }
+            if (other->mAdded.at(0).isSpace() && !mAdded.at(mAdded.length() - 1).isSpace()) {
+                return false;
+            }
+            mAdded.append(other->mAdded);
+            return true;
+        }
+
+        if (mAdded.isEmpty() && other->mAdded.isEmpty() && other->mRemoved.length() == 1) {
+            if (other->mPosition + 1 == mPosition) {
+                mPosition = other->mPosition;
+                mRemoved.prepend(other->mRemoved);
+                return true;
+            }
+            if (other->mPosition == mPosition) {
+                mRemoved.append(other->mRemoved);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+
+    TextHistory *mHistory;
+    int mPosition;
+    QString mRemoved;
+    QString mAdded;
+    bool mApplied;
+};
+
+TextHistory::TextHistory(QTextDocument *document, int limit)
+    : QUndoStack(document),
+      mDocument(document),
+      mText(document->toPlainText()),
+      mApplying(false)
+{
+    setUndoLimit(limit);
+
+    mDocument->setUndoRedoEnabled(false);
+    connect(mDocument, &QTextDocument::contentsChange, this, &TextHistory::onContentsChange);
+}
+
+void TextHistory::replace(int position, int length, const QString &text)
+{
+    mApplying = true;
+
+    QTextCursor cursor(mDocument);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    cursor.insertText(text);
+
+    mApplying = false;
+}
+
+void TextHistory::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    // Changes that span the whole document count the separator after the
+    // last block, which is not part of the text
+    int end = qMin(position + charsAdded, mDocument->characterCount() - 1);
+
+    QTextCursor cursor(mDocument);
+    cursor.setPosition(position);
+    cursor.setPosition(qMax(position, end), QTextCursor::KeepAnchor);
+    QString added = cursor.selectedText();
+    added.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    added.replace(QChar::LineSeparator, QLatin1Char('\n'));
+
+    // The mirror of the text is patched rather than copied again so that the
+    // cost depends on the size of the edit rather than the size of the part
+    QString removed = mText.mid(position, charsRemoved);
+    mText.replace(position, removed.length(), added);
+
+    // Formatting changes leave the text as it was, and changes made by undo
+    // and redo are already on the stack
+    if (mApplying || removed == added) {
+        return;
+    }
+
+    push(new TextChange(this, position, removed, added));
+}
@@ -0,0 +1,60 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Nathan Osman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TEXTHISTORY_H
+#define TEXTHISTORY_H
+
+#include <QString>
+#include <QTextDocument>
+#include <QUndoStack>
+
+/**
+ * @brief Undo history for a document that keeps a limited number of steps.
+ *
+ * The undo stack built into QTextDocument can only be cleared as a whole, so
+ * it is disabled and each change is recorded here as the text it replaced.
+ * Once the limit is reached the oldest steps are dropped.
+ */
+class TextHistory : public QUndoStack
+{
+    Q_OBJECT
+
+public:
+
+    TextHistory(QTextDocument *document, int limit);
+
+    void replace(int position, int length, const QString &text);
+
+private slots:
+
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+
+    QTextDocument *mDocument;
+    QString mText;
+    bool mApplying;
+};
+
+#endif // TEXTHISTORY_H